@@ -9,8 +9,10 @@
 #include <unordered_map>
 #include <string>
 #include <vector>
+#include <optional>
 #include <image/prosper_texture.hpp>
 #include "wguidefinitions.h"
+#include "wgui/types/witext_layout.hpp"
 
 namespace prosper {class IDescriptorSet;};
 
@@ -50,7 +52,8 @@ public:
 	static uint32_t CharToGlyphMapIndex(char c);
 	~FontInfo();
 	void Clear();
-	bool Initialize(const std::string &cpath,uint32_t size);
+	// Monospace fonts are detected automatically unless specified explicitly, see FontMetrics::IsMonospace
+	bool Initialize(const std::string &cpath,uint32_t size,std::optional<bool> monospace={});
 	const FT_Face GetFace() const;
 	const GlyphInfo *GetGlyphInfo(char c) const;
 	const std::vector<std::shared_ptr<GlyphInfo>> &GetGlyphs() const;
@@ -64,6 +67,9 @@ public:
 	prosper::IDescriptorSet *GetGlyphMapDescriptorSet() const;
 	std::shared_ptr<prosper::IBuffer> GetGlyphBoundsBuffer() const;
 	prosper::IDescriptorSet *GetGlyphBoundsDescriptorSet() const;
+	// Snapshot of the glyph metrics, which can be used for text layouts on any thread
+	const std::shared_ptr<const FontMetrics> &GetMetrics() const;
+	bool IsMonospace() const;
 protected:
 	FontInfo()=default;
 	friend FontManager;
@@ -90,18 +96,19 @@ private:
 	std::shared_ptr<prosper::IDescriptorSetGroup> m_glyphMapDescSetGroup = nullptr;
 	std::shared_ptr<prosper::IBuffer> m_glyphBoundsBuffer = nullptr;
 	std::shared_ptr<prosper::IDescriptorSetGroup> m_glyphBoundsDsg = nullptr;
+	std::shared_ptr<const FontMetrics> m_metrics = nullptr;
 };
 
 class DLLWGUI FontManager
 {
 public:
-	static const auto TAB_WIDTH_SPACE_COUNT = 4u;
+	static const auto TAB_WIDTH_SPACE_COUNT = TextLayoutEngine::TAB_WIDTH_SPACE_COUNT;
 	static bool Initialize();
 	static std::shared_ptr<const FontInfo> GetDefaultFont();
 	static const std::unordered_map<std::string,std::shared_ptr<FontInfo>> &GetFonts();
 	static void SetDefaultFont(const FontInfo &font);
 	static const FT_Library GetFontLibrary();
-	static std::shared_ptr<const FontInfo> LoadFont(const std::string &cidentifier,const std::string &cpath,uint32_t fontSize,bool bForceReload=false);
+	static std::shared_ptr<const FontInfo> LoadFont(const std::string &cidentifier,const std::string &cpath,uint32_t fontSize,bool bForceReload=false,std::optional<bool> monospace={});
 	static std::shared_ptr<const FontInfo> GetFont(const std::string &cfontName);
 	static void Close();
 	// Char offset (relative to a line) is required to calculate the correct tab size
@@ -7,6 +7,8 @@
 
 #include "wishader.hpp"
 #include "wgui/wielementdata.hpp"
+#include <limits>
+#include <vector>
 
 class FontInfo;
 namespace wgui
@@ -19,9 +21,12 @@ namespace wgui
 		static prosper::ShaderGraphics::VertexAttribute VERTEX_ATTRIBUTE_POSITION;
 		static prosper::ShaderGraphics::VertexAttribute VERTEX_ATTRIBUTE_UV;
 
+		// Per-glyph instance data, see WIText::GlyphInstance
 		static prosper::ShaderGraphics::VertexBinding VERTEX_BINDING_GLYPH;
 		static prosper::ShaderGraphics::VertexAttribute VERTEX_ATTRIBUTE_GLYPH_INDEX;
-		static prosper::ShaderGraphics::VertexAttribute VERTEX_ATTRIBUTE_GLYPH_BOUNDS;
+		static prosper::ShaderGraphics::VertexAttribute VERTEX_ATTRIBUTE_GLYPH_FLAGS;
+		static prosper::ShaderGraphics::VertexAttribute VERTEX_ATTRIBUTE_GLYPH_POSITION;
+		static prosper::ShaderGraphics::VertexAttribute VERTEX_ATTRIBUTE_GLYPH_COLOR;
 
 		static prosper::DescriptorSetInfo DESCRIPTOR_SET_TEXTURE;
 		static prosper::DescriptorSetInfo DESCRIPTOR_SET_GLYPH_BOUNDS_BUFFER;
@@ -34,16 +39,17 @@ namespace wgui
 			uint32_t glyphMapWidth;
 			uint32_t glyphMapHeight;
 			uint32_t maxGlyphBitmapWidth;
-			uint32_t yOffset;
+			uint32_t lineMetrics; // Line height and font size in pixels, see PackLineMetrics
 		};
 #pragma pack(pop)
+		static uint32_t PackLineMetrics(uint32_t lineHeight,uint32_t fontSize);
 
 		ShaderText(prosper::IPrContext &context,const std::string &identifier);
 		ShaderText(prosper::IPrContext &context,const std::string &identifier,const std::string &vsShader,const std::string &fsShader,const std::string &gsShader="");
 
 		bool Draw(
-			prosper::IBuffer &glyphBoundsIndexBuffer,
-			prosper::IDescriptorSet &descTextureSet,const PushConstants &pushConstants,
+			prosper::IBuffer &glyphBuffer,
+			prosper::IDescriptorSet &descTextureSet,prosper::IDescriptorSet &descGlyphBoundsSet,const PushConstants &pushConstants,
 			uint32_t instanceCount
 		);
 		using Shader::BeginDraw;
@@ -59,45 +65,95 @@ namespace wgui
 		: public ShaderText
 	{
 	public:
+		// Glyph instances are grouped into blocks of this size, with every block belonging to a single line of text.
+		// The sub-line index of a glyph is relative to the origin of its block, which is read from the block origin
+		// buffer at glyphBlockOriginOffset +gl_InstanceIndex /GLYPH_BLOCK_SIZE, so lines can be moved without rewriting
+		// their glyphs. The block origin buffer is shared by all text elements.
+		static constexpr uint32_t GLYPH_BLOCK_SIZE = 8u;
+		static prosper::DescriptorSetInfo DESCRIPTOR_SET_GLYPH_BLOCK_ORIGIN_BUFFER;
 #pragma pack(push,1)
 		struct PushConstants
 		{
 			wgui::ElementData elementData;
 			ShaderText::PushConstants fontInfo;
 			int32_t alphaOnly;
+
+			// Shadow and outline are rendered in the same pass as the text by sampling the glyph map at an offset
+			uint32_t shadowColor; // RGBA8, no shadow is rendered if the alpha is 0
+			uint32_t outlineColor; // RGBA8
+			uint32_t shadowOffset; // Signed 16-bit x and y offsets in pixels, see PackOffset
+			float outlineWidth; // In pixels
+
+			uint32_t glyphBlockOriginOffset; // Index of the first block origin of the element within the block origin buffer
 		};
 #pragma pack(pop)
+		static uint32_t PackColor(const Vector4 &color);
+		static uint32_t PackOffset(const Vector2i &offset);
 
 		ShaderTextRect(prosper::IPrContext &context,const std::string &identifier);
 		ShaderTextRect(prosper::IPrContext &context,const std::string &identifier,const std::string &vsShader,const std::string &fsShader,const std::string &gsShader="");
 
+		// Has to be enabled by the application if its text shaders evaluate the shadow and outline push constants.
+		// Otherwise shadows are rendered in a separate pass and outlines aren't rendered at all.
+		void SetSinglePassEffectsSupported(bool supported);
+		bool AreSinglePassEffectsSupported() const;
+
+		// Glyphs with the HasColor flag use their own color instead of the element color
 		bool Draw(
-			prosper::IBuffer &glyphBoundsIndexBuffer,
-			prosper::IDescriptorSet &descTextureSet,const PushConstants &pushConstants,
-			uint32_t instanceCount
+			prosper::IBuffer &glyphBuffer,
+			prosper::IDescriptorSet &descTextureSet,prosper::IDescriptorSet &descGlyphBoundsSet,prosper::IDescriptorSet &descGlyphBlockOriginSet,
+			const PushConstants &pushConstants,uint32_t instanceCount
+		);
+		// Only draws the specified ranges (first instance, instance count) of the glyph buffer
+		bool Draw(
+			prosper::IBuffer &glyphBuffer,
+			prosper::IDescriptorSet &descTextureSet,prosper::IDescriptorSet &descGlyphBoundsSet,prosper::IDescriptorSet &descGlyphBlockOriginSet,
+			const PushConstants &pushConstants,const std::vector<std::pair<uint32_t,uint32_t>> &instanceRanges
 		);
 	protected:
 		virtual void InitializeRenderPass(std::shared_ptr<prosper::IRenderPass> &outRenderPass,uint32_t pipelineIdx) override;
 		virtual void InitializeGfxPipeline(prosper::GraphicsPipelineCreateInfo &pipelineInfo,uint32_t pipelineIdx) override;
+	private:
+		bool m_singlePassEffectsSupported = false;
 	};
 
+	// Deprecated: The separate color shader has been removed, glyphs with the HasColor flag are rendered by ShaderTextRect
+	using ShaderTextRectColor = ShaderTextRect;
+
 	///////////////////////
 
-	class DLLWGUI ShaderTextRectColor
-		: public ShaderTextRect
+	// Renders the glyphs of multiple text elements at once, see TextBatcher
+	class DLLWGUI ShaderTextBatch
+		: public ShaderText
 	{
 	public:
-		static prosper::ShaderGraphics::VertexBinding VERTEX_BINDING_COLOR;
-		static prosper::ShaderGraphics::VertexAttribute VERTEX_ATTRIBUTE_COLOR;
-		ShaderTextRectColor(prosper::IPrContext &context,const std::string &identifier);
-		ShaderTextRectColor(prosper::IPrContext &context,const std::string &identifier,const std::string &vsShader,const std::string &fsShader,const std::string &gsShader="");
+		static prosper::ShaderGraphics::VertexBinding VERTEX_BINDING_INSTANCE;
+		static prosper::ShaderGraphics::VertexAttribute VERTEX_ATTRIBUTE_GLYPH_INDEX;
+		static prosper::ShaderGraphics::VertexAttribute VERTEX_ATTRIBUTE_GLYPH_FLAGS;
+		static prosper::ShaderGraphics::VertexAttribute VERTEX_ATTRIBUTE_GLYPH_POSITION;
+		static prosper::ShaderGraphics::VertexAttribute VERTEX_ATTRIBUTE_GLYPH_COLOR;
+		static prosper::ShaderGraphics::VertexAttribute VERTEX_ATTRIBUTE_DRAW_INDEX;
+
+		// Per-element data (model matrix, color and clip rectangle), see TextBatcher::DrawData
+		static prosper::DescriptorSetInfo DESCRIPTOR_SET_DRAW_DATA_BUFFER;
+#pragma pack(push,1)
+		struct PushConstants
+		{
+			ShaderText::PushConstants fontInfo;
+			uint32_t drawDataOffset; // Index of the first draw data entry of the flush within the draw data buffer
+		};
+#pragma pack(pop)
+
+		ShaderTextBatch(prosper::IPrContext &context,const std::string &identifier);
+		ShaderTextBatch(prosper::IPrContext &context,const std::string &identifier,const std::string &vsShader,const std::string &fsShader,const std::string &gsShader="");
 
 		bool Draw(
-			prosper::IBuffer &glyphBoundsIndexBuffer,prosper::IBuffer &colorBuffer,
-			prosper::IDescriptorSet &descTextureSet,const PushConstants &pushConstants,
-			uint32_t instanceCount
+			prosper::IBuffer &instanceBuffer,prosper::DeviceSize instanceBufferOffset,
+			prosper::IDescriptorSet &descTextureSet,prosper::IDescriptorSet &descGlyphBoundsSet,prosper::IDescriptorSet &descDrawDataSet,
+			const PushConstants &pushConstants,uint32_t instanceCount
 		);
 	protected:
+		virtual void InitializeRenderPass(std::shared_ptr<prosper::IRenderPass> &outRenderPass,uint32_t pipelineIdx) override;
 		virtual void InitializeGfxPipeline(prosper::GraphicsPipelineCreateInfo &pipelineInfo,uint32_t pipelineIdx) override;
 	};
 };
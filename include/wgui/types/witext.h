@@ -9,71 +9,37 @@
 #include "wgui/fontmanager.h"
 #include "wgui/wihandle.h"
 #include "wgui/shaders/wishader_text.hpp"
+#include "wgui/types/witext_line_offset_tree.hpp"
+#include "wgui/types/witext_cache_atlas.hpp"
+#include "wgui/types/witext_blur_compositor.hpp"
+#include "wgui/types/witext_tags.hpp"
 #include <image/prosper_render_target.hpp>
 #include <sharedutils/property/util_property.hpp>
 #include <sharedutils/util_shared_handle.hpp>
 #include <util_formatted_text_types.hpp>
 #include <string_view>
 #include <queue>
-#ifdef __linux__
-	#include "wgui/types/witext_tags.hpp"
-#endif
+#include <deque>
+#include <map>
+#include <optional>
+#include <limits>
 
 namespace prosper
 {
 	class IBuffer;
 	class Shader;
-	class BlurSet;
-	class IUniformResizableBuffer;
+	class IDynamicResizableBuffer;
 	class IDescriptorSet;
+	class IDescriptorSetGroup;
 };
 
 namespace util{namespace text{class FormattedText; class TextTag; class FormattedTextLine;};};
 class WGUIShaderText;
 class WITextTag;
+class WITextTagColor;
 class WITextDecorator;
 struct WITextTagArgument;
 
-class WIText;
-class DLLWGUI WITextBase
-	: public WIBase
-{
-public:
-	struct SubBufferInfo
-	{
-		std::shared_ptr<prosper::IBuffer> buffer;
-		std::shared_ptr<prosper::IBuffer> colorBuffer;
-		util::text::TextLength numChars = 0u;
-		util::text::CharOffset charOffset = 0u;
-		util::text::LineIndex absLineIndex = 0;
-		uint32_t width = 0u;
-		uint32_t height = 0u;
-		float sx = 0.f;
-		float sy = 0.f;
-	};
-
-	virtual void Render(const DrawInfo &drawInfo,const Mat4 &matDraw) override;
-	void InitializeTexture(prosper::Texture &tex,int32_t w,int32_t h);
-	void SetTextElement(WIText &elText);
-private:
-	bool RenderLines(
-		wgui::ShaderTextRect &shader,int32_t width,int32_t height,
-		const Vector2i &absPos,const Mat4 &transform,
-		const Vector2i &origin,const Mat4 &matParent,Vector2i &inOutSize,
-		wgui::ShaderTextRect::PushConstants &inOutPushConstants,
-		const std::function<void(const SubBufferInfo&,prosper::IDescriptorSet&)> &fDraw,
-		bool colorPass
-	) const;
-	void RenderLines(
-		int32_t width,int32_t height,
-		const Vector2i &absPos,const Mat4 &transform,
-		const Vector2i &origin,const Mat4 &matParent,Vector2i &inOutSize,
-		wgui::ShaderTextRect::PushConstants &inOutPushConstants
-	) const;
-	WIHandle m_hTexture = {};
-	WIHandle m_hText = {};
-};
-
 class DLLWGUI WIText
 	: public WIBase
 {
@@ -85,7 +51,8 @@ public:
 		int32_t GetEndOffset() const {return offset +length -1;} // Note: May be negative if length is 0
 		void SetEndOffset(int32_t endOffset) {length = endOffset -offset +1;}
 	};
-	friend WITextBase;
+	friend WITextTagColor;
+	friend WITextDecorator;
 public:
 	enum class AutoBreak : int
 	{
@@ -93,7 +60,7 @@ public:
 		ANY,
 		WHITESPACE
 	};
-	enum class Flags : uint8_t
+	enum class Flags : uint16_t
 	{
 		None = 0u,
 		RenderTextScheduled = 1u,
@@ -102,7 +69,16 @@ public:
 		Cache = FullUpdateScheduled<<1u,
 		TextDirty = Cache<<1u,
 		ApplySubTextTags = TextDirty<<1u,
-		HideText = ApplySubTextTags<<1u // If enabled, text will be rendered as '*'
+		HideText = ApplySubTextTags<<1u, // If enabled, text will be rendered as '*'
+		Virtualized = HideText<<1u, // If enabled, glyph buffers will only be created for lines that are (close to being) visible
+		HasGlyphColors = Virtualized<<1u, // At least one glyph has a color of its own (i.e. the text has color tags)
+		DecorationsDirty = HasGlyphColors<<1u,
+		HasInteractiveDecorators = DecorationsDirty<<1u, // The text contains links or tooltips, which are hit-tested on mouse input
+		PostProcessingPending = HasInteractiveDecorators<<1u, // Text has been changed during an edit, see BeginTextEdit
+		BulkTextUpdate = PostProcessingPending<<1u, // The entire text is being replaced, line callbacks only build the line table (see SetText)
+		// Mouse input / movement checks have been enabled for interactive decorators and have to be disabled again when they're gone
+		DecoratorsEnabledMouseInput = BulkTextUpdate<<1u,
+		DecoratorsEnabledMouseMovementCheck = DecoratorsEnabledMouseInput<<1u
 	};
 	enum class TagType : uint32_t
 	{
@@ -113,29 +89,90 @@ public:
 		Tooltip,
 		Template
 	};
+#pragma pack(push,1)
+	// Glyph dimensions and bearings are looked up in the glyph bounds buffer of the font by the shader,
+	// so only the pen position has to be stored per glyph.
+	struct GlyphInstance
+	{
+		enum class Flags : uint16_t
+		{
+			None = 0u,
+			Visible = 1u, // Unused instances are still part of the draw call, but won't produce any fragments
+			HasColor = Visible<<1u // The glyph uses its own color instead of the color of the text element
+		};
+		uint16_t index = 0u;
+		Flags flags = Flags::None;
+		uint32_t x = 0u; // Pen position in pixels
+		uint32_t subLine = 0u; // Sub-line index relative to the line (see m_glyphBlockOrigins); The vertical position is sub-line index *line height
+		uint32_t color = 0u; // RGBA8, see wgui::ShaderTextRect::PackColor
+	};
+#pragma pack(pop)
+	// Colors a range of characters of a line directly, without color tags (e.g. for syntax highlighting)
+	struct DLLWGUI ColorSpan
+	{
+		util::text::CharOffset offset = 0; // Relative to the line
+		util::text::TextLength length = 0;
+		uint32_t color = 0u; // RGBA8, see wgui::ShaderTextRect::PackColor
+	};
 	struct DLLWGUI LineInfo
 	{
 		LineInfo()=default;
 		std::weak_ptr<util::text::FormattedTextLine> wpLine;
 		int32_t widthInPixels = 0u;
 		bool bufferUpdateRequired = true;
-		util::text::LineIndex subLineIndexOffset = 0;
-		std::vector<WITextBase::SubBufferInfo> buffers = {};
+		bool dirty = false;
+		// Range of glyph instances reserved for this line in the glyph buffer of the text element (one instance per character)
+		uint32_t glyphOffset = 0u;
+		uint32_t glyphCapacity = 0u;
+		// Sub-line offset of the line in the glyph block origins
+		util::text::LineIndex glyphSubLineIndexOffset = 0;
 		std::vector<util::text::TextLength> subLines = {};
+		// Start offset of each sub-line relative to the line (i.e. the prefix sums of subLines); Empty if the line isn't broken
+		std::vector<util::text::CharOffset> subLineOffsets = {};
+
+		// Pixel offset of each character relative to the start of the line, followed by the width of the entire line.
+		// These don't depend on the element width, so they only have to be updated if the contents of the line change.
+		std::vector<int32_t> charPxOffsets = {};
+		// Character offsets the line may be broken at in AutoBreak::WHITESPACE mode (i.e. the offsets following a whitespace character)
+		std::vector<util::text::CharOffset> breakOffsets = {};
+		bool metricsUpdateRequired = true;
+
+		// Sorted by offset, see SetLineColorSpans. Applied whenever the glyph instances of the line are re-initialized.
+		std::vector<ColorSpan> colorSpans = {};
 	};
-	static const auto MAX_CHARS_PER_BUFFER = 32u;
+
+	// Line glyph ranges are rounded up to this, so small edits don't require a new range. Every block of
+	// instances belongs to a single line, see m_glyphBlockOrigins.
+	static constexpr uint32_t GLYPH_RANGE_ALIGNMENT = wgui::ShaderTextRect::GLYPH_BLOCK_SIZE;
+	// Glyphs of long lines are culled horizontally in chunks of this size
+	static constexpr uint32_t GLYPH_CULL_CHUNK_SIZE = 32u;
+	static constexpr uint32_t MIN_GLYPH_BUFFER_INSTANCE_COUNT = 256u;
+	// Initial size of the glyph instance buffer shared by all text elements, which can grow up to five times this size
+	static constexpr uint32_t TEXT_BUFFER_INSTANCE_COUNT = 262'144u;
 
 	WIText();
 	virtual ~WIText() override;
 	WIText(const WIText&)=delete;
 	void operator=(const WIText&)=delete;
 	virtual void Initialize() override;
-	WITextBase *GetBaseElement();
 	const FontInfo *GetFont() const;
 	uint32_t GetLineCount() const;
 	uint32_t GetTotalLineCount() const;
-	const std::vector<LineInfo> &GetLines() const;
-	std::vector<LineInfo> &GetLines();
+	util::text::LineIndex GetSubLineIndexOffset(util::text::LineIndex lineIdx) const;
+	// Returns the index of the line containing the specified (absolute) sub-line
+	util::text::LineIndex GetLineIndexFromSubLineIndex(util::text::LineIndex subLineIdx) const;
+	// Offset of the first character of the line, relative to the formatted text
+	util::text::TextOffset GetLineStartOffset(util::text::LineIndex lineIdx) const;
+	// Returns the index of the line containing the specified offset (relative to the formatted text), or the last line if the offset is out of range
+	util::text::LineIndex GetLineIndexFromTextOffset(util::text::TextOffset offset) const;
+	// Returns the index of the sub-line (relative to the line) containing the specified character. An offset at the end of a sub-line belongs to the next sub-line.
+	util::text::LineIndex GetSubLineIndex(util::text::LineIndex lineIdx,util::text::CharOffset charOffset) const;
+	// Returns the horizontal pixel offset of the character, relative to the start of its sub-line
+	int32_t GetCharPixelOffset(util::text::LineIndex lineIdx,util::text::CharOffset charOffset);
+	// Returns the character offset (relative to the line) within the specified sub-line that is closest to the horizontal pixel offset x (relative to the start of the sub-line)
+	util::text::CharOffset FindCharOffset(util::text::LineIndex lineIdx,util::text::LineIndex relSubLineIdx,int32_t x);
+	const std::deque<LineInfo> &GetLines() const;
+	std::deque<LineInfo> &GetLines();
 	util::text::FormattedTextLine *GetLine(util::text::LineIndex lineIdx);
 	int GetLineHeight() const;
 	int GetBreakHeight();
@@ -144,6 +181,8 @@ public:
 	util::text::FormattedText &GetFormattedTextObject();
 	const std::string &GetText() const;
 	const std::string &GetFormattedText() const;
+	// Single-line texts without tags (e.g. labels with counters) are edited in place instead of being replaced,
+	// which keeps the glyph range of the line and only updates the glyphs that have changed
 	void SetText(const std::string_view &text);
 	void SetFont(const std::string_view &font);
 	void SetFont(const FontInfo *font);
@@ -153,6 +192,8 @@ public:
 	virtual void SetSize(int x,int y) override;
 	int GetTextHeight();
 	std::shared_ptr<prosper::Texture> GetTexture() const;
+	// Cached texts only occupy a region of the texture returned by GetTexture, see TextCacheAtlas
+	Vector4 GetTextureUvRect() const;
 	virtual std::string GetDebugInfo() const override;
 	std::pair<Vector2i,Vector2i> GetCharacterPixelBounds(util::text::LineIndex lineIdx,util::text::CharOffset charOffset) const;
 	void SetTagArgument(const std::string &tagLabel,uint32_t argumentIndex,const std::string &arg);
@@ -162,14 +203,30 @@ public:
 	void SetTagsEnabled(bool bEnabled);
 	bool AreTagsEnabled() const;
 	Color GetCharColor(util::text::TextOffset offset) const;
+	// Replaces the color spans of a line. Spans are kept until they're replaced or the line is removed, i.e. they
+	// aren't moved if the contents of the line change. Color tags take precedence over color spans.
+	// Cached texts are stored as coverage only and drawn with the element color, so neither color spans nor color
+	// tags are applied while caching is enabled (see SetCacheEnabled).
+	void SetLineColorSpans(util::text::LineIndex lineIdx,const ColorSpan *spans,uint32_t numSpans);
+	void SetLineColorSpans(util::text::LineIndex lineIdx,const std::vector<ColorSpan> &spans);
+	void ClearColorSpans();
 
 	bool IsTextHidden() const;
 	void HideText(bool hide=true);
 
+	// Edits that affect multiple lines trigger the line callbacks once per line. Between these calls the element
+	// won't be resized to the text, which only happens once the outermost edit has ended. Calls can be nested.
+	void BeginTextEdit();
+	void EndTextEdit();
 	void AppendText(const std::string_view &text);
 	bool InsertText(const std::string_view &text,util::text::LineIndex lineIdx,util::text::CharOffset charOffset=util::text::LAST_CHAR);
 	void AppendLine(const std::string_view &line);
 	void PopFrontLine();
+	// In log mode the text keeps at most the specified number of lines. Appending text to a full log removes the
+	// first lines, and their line infos and glyph ranges are re-used for the new lines. A capacity of 0 disables log mode.
+	void SetLogMode(uint32_t lineCapacity);
+	bool IsLogModeEnabled() const;
+	uint32_t GetLogLineCapacity() const;
 	void PopBackLine();
 	void RemoveLine(util::text::LineIndex lineIdx);
 	bool RemoveText(util::text::LineIndex lineIdx,util::text::CharOffset charOffset,util::text::TextLength len);
@@ -204,20 +261,44 @@ public:
 	float GetShadowBlurSize();
 	//
 
+	// Outline (Not supported in cached mode). Requires a text shader with single-pass effects, see wgui::ShaderTextRect::SetSinglePassEffectsSupported
+	void SetOutlineWidth(float width);
+	float GetOutlineWidth() const;
+	void SetOutlineColor(const Vector4 &col);
+	const Vector4 &GetOutlineColor() const;
+	//
+
 	virtual void SelectShader();
 	virtual void Think() override;
+	virtual void Render(const DrawInfo &drawInfo,const Mat4 &matDraw) override;
 	virtual void SizeToContents(bool x=true,bool y=true) override;
 	virtual Mat4 GetTransformedMatrix(const Vector2i &origin,int w,int h,Mat4 mat) const override;
 
+	// Per-character colors (color tags and color spans) are ignored in cached mode
 	void SetCacheEnabled(bool bEnabled);
 	bool IsCacheEnabled() const;
 
+	// Intended for texts with a very large number of lines (e.g. logs). Lines that are out of view
+	// won't occupy any GPU memory. The visible range is updated every frame while the element is thinking.
+	void SetVirtualized(bool virtualized);
+	bool IsVirtualized() const;
+
 	template<class TDecorator,typename... TARGS>
 		std::shared_ptr<WITextDecorator> AddDecorator(TARGS&& ...args);
 	void RemoveDecorator(const WITextDecorator &decorator);
+	// Returns the interactive decorator (link or tooltip) covering the character at the specified position (relative to this element)
+	WITextDecorator *FindInteractiveDecorator(const Vector2i &pos);
+
+	virtual void SetMouseInputEnabled(bool b) override;
+	virtual void OnCursorMoved(int x,int y) override;
+	virtual void OnCursorEntered() override;
+	virtual void OnCursorExited() override;
+	virtual util::EventReply MouseCallback(GLFW::MouseButton button,GLFW::KeyState state,GLFW::Modifier mods) override;
 
 	static void InitializeTextBuffer(prosper::IPrContext &context);
 	static void ClearTextBuffer();
+	// Records the blur passes for all blurred text shadows that have changed this frame
+	static void FlushBlurredShadows();
 private:
 	struct WITextShadowInfo
 	{
@@ -229,17 +310,76 @@ private:
 		Vector4 color;
 		float blurSize;
 	};
+	struct WITextOutlineInfo
+	{
+		float width = 0.f;
+		Vector4 color = {0.f,0.f,0.f,1.f};
+	};
 private:
-	static std::shared_ptr<prosper::IUniformResizableBuffer> s_textBuffer;
+	static std::shared_ptr<prosper::IDynamicResizableBuffer> s_textBuffer;
+	// Glyph block origins of all text elements, bound through a single descriptor set. Elements pass the offset of
+	// their first block as push constant.
+	static std::shared_ptr<prosper::IDynamicResizableBuffer> s_glyphBlockOriginBuffer;
+	static std::shared_ptr<prosper::IDescriptorSetGroup> s_glyphBlockOriginDsg;
+	static std::unique_ptr<TextCacheAtlas> s_cacheAtlas;
+	static std::unique_ptr<TextBlurCompositor> s_blurCompositor;
 	util::WeakHandle<prosper::Shader> m_shader = {};
 	std::shared_ptr<util::text::FormattedText> m_text = nullptr;
-	std::vector<LineInfo> m_lineInfos = {};
+	std::deque<LineInfo> m_lineInfos = {};
+	TextLineOffsetTree m_subLineOffsets = {};
+	TextLineOffsetTree m_lineTextOffsets = {}; // Formatted length of each line (including the new-line character)
+	std::vector<std::weak_ptr<util::text::FormattedTextLine>> m_dirtyLines = {};
+	// Width of the widest line, see GetMaxLineWidth. Only lines that have been added or changed since have to be measured,
+	// the entire text is only measured again if the widest line may have become narrower.
+	int32_t m_maxLineWidth = 0;
+	bool m_maxLineWidthValid = true;
+	std::vector<std::weak_ptr<util::text::FormattedTextLine>> m_unmeasuredLines = {};
+	int32_t m_lineBreakWidth = -1;
+	uint32_t m_textEditDepth = 0u;
+	uint32_t m_logLineCapacity = 0u;
+	std::optional<LineInfo> m_recycledLineInfo = {}; // Line info of the last line removed in log mode
+
+	// Glyph instances of all lines, see LineInfo::glyphOffset. The entire text is rendered with a single instanced draw call.
+	std::shared_ptr<prosper::IBuffer> m_glyphBuffer = nullptr;
+	std::vector<GlyphInstance> m_glyphInstances = {};
+	uint32_t m_numGlyphInstances = 0u;
+	uint32_t m_numFreeGlyphInstances = 0u;
+	std::vector<std::pair<uint32_t,uint32_t>> m_freeGlyphRanges = {}; // Sorted by offset, neighboring ranges are merged
+	std::vector<std::pair<uint32_t,uint32_t>> m_dirtyGlyphRanges = {};
+	// Sub-line index of the line each block of GLYPH_RANGE_ALIGNMENT glyph instances belongs to. Glyph sub-line indices
+	// are relative to their block, so moving a line vertically only has to update the origins of its blocks.
+	std::shared_ptr<prosper::IBuffer> m_glyphBlockOriginBuffer = nullptr; // Sub-buffer of s_glyphBlockOriginBuffer
+	std::vector<uint32_t> m_glyphBlockOrigins = {};
+	std::pair<uint32_t,uint32_t> m_dirtyGlyphBlockRange = {0u,0u}; // Range of blocks that have to be uploaded [first,last)
+	std::vector<std::pair<uint32_t,uint32_t>> m_visibleGlyphRanges = {}; // Only used by RenderLines, kept to avoid re-allocations
+	std::vector<util::text::LineIndex> m_dirtyLineIndices = {}; // Only used by UpdateRenderTexture, kept to avoid re-allocations
+	std::vector<GlyphInstance> m_lineGlyphInstances = {}; // Only used by InitializeTextBuffers, kept to avoid re-allocations
+	util::text::LineIndex m_firstShiftedLine = std::numeric_limits<util::text::LineIndex>::max();
+	// Glyph block origins are stored relative to this sub-line, so removing the first line doesn't move any lines.
+	// Instead, the text is rendered with a vertical offset.
+	util::text::LineIndex m_subLineOrigin = 0;
+	//
+
+	// Virtualization
+	std::pair<util::text::LineIndex,util::text::LineIndex> m_materializedSubLineRange = {0,0};
+	std::vector<std::weak_ptr<util::text::FormattedTextLine>> m_materializedLines = {};
+	//
 
 	std::vector<std::shared_ptr<WITextDecorator>> m_tagInfos = {};
+	std::vector<std::weak_ptr<WITextDecorator>> m_dirtyDecorators = {}; // Decorators that have to be re-applied, see ApplySubTextTags
+	// Largest number of lines any applied (closed) decorator spans, used to limit the search for the decorators covering a line.
+	// The number of decorators per span is kept, so the maximum can be lowered again when decorators are removed.
+	util::text::LineIndex m_maxDecoratorLineSpan = 0;
+	std::map<util::text::LineIndex,uint32_t> m_decoratorLineSpans = {};
+	std::vector<std::weak_ptr<WITextDecorator>> m_unclosedDecorators = {}; // Decorators without an end, which cover all following lines
+	std::weak_ptr<WITextDecorator> m_hoveredDecorator = {};
+	std::optional<std::string> m_elementTooltip = {}; // Tooltip of the element itself, while it's replaced by the tooltip of a decorator
+	std::optional<GLFW::Cursor::Shape> m_elementCursor = {}; // Cursor of the element itself, while it's replaced by the cursor of a decorator
+	uint32_t m_numInteractiveDecorators = 0u;
 	std::unordered_map<std::string,std::vector<std::weak_ptr<WITextTag>>> m_labelToDecorators = {};
 
 	std::unordered_map<std::string,std::unordered_map<uint32_t,WITextTagArgument>> m_tagArgumentOverrides = {};
-	WIHandle m_baseEl;
+	WIHandle m_cacheRect; // Displays the cached text, only exists while caching is enabled
 	std::shared_ptr<const FontInfo> m_font;
 	int m_breakHeight;
 	AutoBreak m_autoBreak;
@@ -249,20 +389,43 @@ private:
 	// Shadow
 	WIHandle m_baseTextShadow;
 	WITextShadowInfo m_shadow;
+	WITextOutlineInfo m_outline;
 	//
 
 	// Render Text
-	std::shared_ptr<prosper::RenderTarget> m_renderTarget = nullptr;
-	std::shared_ptr<prosper::RenderTarget> m_shadowRenderTarget = nullptr;
-	std::shared_ptr<prosper::BlurSet> m_shadowBlurSet = nullptr;
+	std::shared_ptr<prosper::RenderTarget> m_renderTarget = nullptr; // Atlas page containing the cached text
+	TextCacheAtlas::Region m_cacheRegion = {};
+	TextBlurCompositor::Region m_shadowBlurRegion = {}; // Only valid for blurred shadows
 	//
 
 	Flags m_flags = Flags::FullUpdateScheduled;
 	unsigned int m_wTexture;
 	unsigned int m_hTexture;
 
-	bool BreakLineByWidth(uint32_t lineIndex,util::text::ShiftOffset &lineShift);
-	void UpdateSubLines();
+	bool BreakLineByWidth(uint32_t lineIndex);
+	void UpdateSubLines(std::vector<util::text::LineIndex> &inOutLineIndices);
+	void MarkLineDirty(util::text::LineIndex lineIdx);
+	void MarkAllLinesDirty();
+	void PopDirtyLines(std::vector<util::text::LineIndex> &outLineIndices);
+	bool ReplaceLineText(const std::string_view &text);
+	void MarkLineTagsDirty(util::text::LineIndex lineIdx);
+	void MarkShiftedDecoratorsDirty(util::text::LineIndex firstLineIdx);
+	void MarkDecoratorDirty(WITextDecorator &decorator);
+	std::vector<std::shared_ptr<WITextDecorator>>::iterator FindFirstDecoratorCoveringLine(util::text::LineIndex lineIdx);
+	// Calls the function for all decorators that may cover any of the lines in the range [startLineIdx,endLineIdx], until it returns false
+	void IterateDecorators(util::text::LineIndex startLineIdx,util::text::LineIndex endLineIdx,const std::function<bool(WITextDecorator&)> &f);
+	void SetDecoratorLineSpan(WITextDecorator &decorator,std::optional<util::text::LineIndex> lineSpan);
+	void OnDecoratorRemoved(WITextDecorator &decorator);
+	void OnDecoratorRangeChanged(WITextDecorator &decorator);
+	void UpdateLineMetrics(LineInfo &lineInfo);
+	void MarkLineMetricsDirty(LineInfo &lineInfo);
+	void QueueLineMeasurement(const LineInfo &lineInfo);
+	void InvalidateMaxLineWidth();
+	int32_t GetMaxLineWidth();
+	LineInfo *GetUpdatedLineInfo(util::text::LineIndex lineIdx);
+	void UpdateLineTextOffset(util::text::LineIndex lineIdx);
+	void InitializeLineOffsets();
+	void InvalidateLineMetrics();
 	
 	void PerformTextPostProcessing();
 	void AutoSizeToText();
@@ -272,19 +435,56 @@ private:
 	void SetTagArgument(const std::string &tagLabel,uint32_t argumentIndex,const WITextTagArgument &arg);
 	void ApplySubTextTags();
 	void ApplySubTextTag(WITextDecorator &tag);
-	void InitializeTextBuffers();
-	void InitializeTextBuffers(LineInfo &lineInfo,util::text::LineIndex lineIndex);
+	void UpdateDecorations();
+	void SetHoveredDecorator(WITextDecorator *decorator);
+	void InitializeTextBuffers(const std::vector<util::text::LineIndex> &lineIndices);
+	void InitializeTextBuffers(LineInfo &lineInfo);
+	std::pair<util::text::LineIndex,util::text::LineIndex> GetMaterializedLineRange() const;
+	void SetVisibleSubLineRange(util::text::LineIndex startSubLineIdx,util::text::LineIndex endSubLineIdx);
+	void UpdateVisibleSubLineRange();
+	void UpdateMaterializedLines();
+	void ReleaseTextBuffers(LineInfo &lineInfo);
+	void UpdateShiftedLines();
+	// Collects the ranges (offset, count) of the glyph instances within the specified rectangle in pixels relative to the element,
+	// sorted by offset. The margin is added in every direction to account for glyph bearings and effects like shadows.
+	void CollectVisibleGlyphRanges(
+		int32_t xStart,int32_t yStart,int32_t xEnd,int32_t yEnd,int32_t margin,
+		std::vector<std::pair<uint32_t,uint32_t>> &outRanges
+	) const;
+	void UpdateSubLineOrigin();
+	void RecycleLineInfo(LineInfo &lineInfo);
+	LineInfo PopRecycledLineInfo();
+	void ApplyLogLineCapacity();
+	uint32_t AllocateGlyphRange(uint32_t count);
+	void FreeGlyphRange(uint32_t offset,uint32_t count);
+	void ReserveGlyphInstances(uint32_t count);
+	void CompactGlyphInstances();
+	void MarkGlyphRangeDirty(uint32_t offset,uint32_t count);
+	void SetGlyphBlockOrigin(LineInfo &lineInfo,util::text::LineIndex origin);
+	void SetGlyphColors(const LineInfo &lineInfo,util::text::CharOffset startOffset,util::text::CharOffset endOffset,const Vector4 &color);
+	void ApplyColorSpans(const LineInfo &lineInfo,GlyphInstance *instances,uint32_t numInstances) const;
+	void UploadGlyphInstances();
 	void UpdateRenderTexture();
 	void GetTextSize(int *w,int *h,const std::string_view *inText=nullptr);
 	void RenderText();
 	void RenderText(Mat4 &mat);
+	// Clears the viewport (plus the padding to the right and bottom of it) and renders the glyphs into it
+	void RenderCachedGlyphs(prosper::RenderTarget &rt,uint32_t vpX,uint32_t vpY,uint32_t vpWidth,uint32_t vpHeight,uint32_t padding);
+	void InitializeCacheRect(prosper::Texture &tex,int32_t w,int32_t h,const Vector4 &uvRect);
+	void RenderLines(
+		int32_t width,int32_t height,
+		const Vector2i &absPos,const Mat4 &transform,
+		const Vector2i &origin,const Mat4 &matParent,Vector2i &inOutSize,
+		wgui::ShaderTextRect::PushConstants &inOutPushConstants
+	);
+	void RenderDecorations(const DrawInfo &drawInfo,const Mat4 &matDraw,WITextDecorator::Quad::Layer layer);
 	void InitializeShadow(bool bReload=false);
 	void DestroyShadow();
-	void InitializeBlur(bool bReload=false);
-	void DestroyBlur();
+	void ReleaseCacheRegion();
 	void ScheduleRenderUpdate(bool bFull=false);
 };
 REGISTER_BASIC_BITWISE_OPERATORS(WIText::Flags)
+REGISTER_BASIC_BITWISE_OPERATORS(WIText::GlyphInstance::Flags)
 
 template<class TDecorator,typename... TARGS>
 	std::shared_ptr<WITextDecorator> WIText::AddDecorator(TARGS&& ...args)
@@ -295,9 +495,15 @@ template<class TDecorator,typename... TARGS>
 		InitializeTagArguments(*pDecorator,pDecorator->GetArguments());
 	}
 	pDecorator->Initialize();
+	if(pDecorator->IsInteractive())
+	{
+		++m_numInteractiveDecorators;
+		m_flags |= Flags::DecorationsDirty;
+	}
+	// Decorators are sorted by their start offset; Tags are usually added in text order, in which case this is an append
 	auto startOffset = pDecorator->GetStartTextCharOffset();
-	auto it = std::find_if(m_tagInfos.begin(),m_tagInfos.end(),[startOffset](const std::shared_ptr<WITextDecorator> &decoratorOther) {
-		return decoratorOther->GetStartTextCharOffset() >= startOffset;
+	auto it = std::lower_bound(m_tagInfos.begin(),m_tagInfos.end(),startOffset,[](const std::shared_ptr<WITextDecorator> &decoratorOther,util::text::TextOffset offset) {
+		return decoratorOther->GetStartTextCharOffset() < offset;
 	});
 	m_tagInfos.insert(it,pDecorator);
 	pDecorator->SetDirty();
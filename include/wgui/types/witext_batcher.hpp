@@ -0,0 +1,75 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __WITEXT_BATCHER_HPP__
+#define __WITEXT_BATCHER_HPP__
+
+#include "wgui/wguidefinitions.h"
+#include "wgui/types/witext.h"
+#include <mathutil/uvec.h>
+#include <vector>
+#include <memory>
+
+class FontInfo;
+namespace prosper {class IBuffer; class IDescriptorSetGroup;};
+
+// Collects the glyphs of all text elements rendered during WGUI::Draw and renders them
+// with one draw call per font. Pending glyphs are flushed whenever a different shader
+// starts drawing, so the draw order of the elements is preserved.
+class DLLWGUI TextBatcher
+{
+public:
+#pragma pack(push,1)
+	struct Instance
+	{
+		WIText::GlyphInstance glyph;
+		uint32_t drawIndex; // Index into the draw data of the flush, see DrawData
+	};
+#pragma pack(pop)
+	// Data shared by all glyphs of a text element, read from a storage buffer by the batch shader
+	struct DrawData
+	{
+		Mat4 modelMatrix;
+		Vector4 color; // Color of the text element
+		Vector4 clip; // Scissor rectangle (x,y,w,h) in pixels
+	};
+
+	void Begin();
+	void End();
+	bool IsActive() const;
+	bool IsEmpty() const;
+
+	// Glyphs with a color of their own will use that color, multiplied by the alpha of the specified color.
+	// The sub-line indices of the glyphs are resolved with the block origins, see WIText::GLYPH_RANGE_ALIGNMENT.
+	// Only the glyphs in the specified ranges (first glyph, glyph count) are added.
+	void Add(
+		const std::shared_ptr<const FontInfo> &font,uint32_t lineHeight,uint32_t width,uint32_t height,const Mat4 &modelMatrix,const Vector4 &color,
+		const WIText::GlyphInstance *glyphs,const uint32_t *glyphBlockOrigins,const std::vector<std::pair<uint32_t,uint32_t>> &glyphRanges
+	);
+	void Flush();
+	void Clear();
+private:
+	struct Batch
+	{
+		std::shared_ptr<const FontInfo> font = nullptr;
+		uint32_t lineHeight = 0u;
+		std::vector<Instance> instances = {};
+	};
+	struct DrawDataDescriptorSet
+	{
+		std::shared_ptr<prosper::IBuffer> buffer = nullptr;
+		std::shared_ptr<prosper::IDescriptorSetGroup> dsg = nullptr;
+	};
+	prosper::IDescriptorSetGroup *GetDrawDataDescriptorSet(const std::shared_ptr<prosper::IBuffer> &buffer);
+	void ReleaseDrawDataDescriptorSets();
+	std::vector<Batch> m_batches = {};
+	std::vector<DrawData> m_drawData = {};
+	// One descriptor set per staging buffer the draw data has been written to during the current frame, see UploadManager::AllocateFrameData
+	std::vector<DrawDataDescriptorSet> m_drawDataDescriptorSets = {};
+	uint32_t m_width = 0u;
+	uint32_t m_height = 0u;
+	bool m_active = false;
+};
+
+#endif
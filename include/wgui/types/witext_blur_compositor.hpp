@@ -0,0 +1,83 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __WITEXT_BLUR_COMPOSITOR_HPP__
+#define __WITEXT_BLUR_COMPOSITOR_HPP__
+
+#include "wgui/wguidefinitions.h"
+#include "wgui/types/witext_cache_atlas.hpp"
+#include <mathutil/uvec.h>
+#include <functional>
+#include <vector>
+#include <memory>
+#include <array>
+#include <map>
+#include <set>
+
+namespace prosper {class RenderTarget; class IRenderPass; class Texture; class BlurSet;};
+
+// Collects the sources of all blurred text shadows in half-resolution atlas pages (one set of pages per blur size),
+// so that a single blur pass per page is required, instead of one per text element. The unblurred sources are kept,
+// so only invalidated sources have to be re-rendered before a page is blurred again.
+class DLLWGUI TextBlurCompositor
+{
+public:
+	static constexpr uint32_t PAGE_SIZE = 1'024u;
+	static constexpr uint32_t RESOLUTION_DIVISOR = 2u;
+	static constexpr uint32_t BLUR_KERNEL_SIZE = 9u;
+	// Renders the source of a region into the specified viewport of the render target. The viewport and the padding
+	// to the right and bottom of it have to be cleared first.
+	using RenderFunction = std::function<void(prosper::RenderTarget&,uint32_t,uint32_t,uint32_t,uint32_t,uint32_t)>;
+	struct DLLWGUI Region
+	{
+		float blurSize = 0.f;
+		TextCacheAtlas::Region atlasRegion = {};
+		bool IsValid() const;
+	};
+	// Space between two regions, which has to cover the blur radius, otherwise neighboring regions bleed into each other
+	static uint32_t GetRegionPadding(float blurSize);
+
+	TextBlurCompositor(prosper::IRenderPass &renderPass);
+	// Width and height are specified in full resolution
+	Region Allocate(float blurSize,uint32_t width,uint32_t height,const RenderFunction &fRender);
+	void Free(Region &region);
+	// Returns false if the region is invalid or has been allocated by a different compositor
+	bool IsValid(const Region &region) const;
+	// Schedules the source of the region to be re-rendered and its page to be blurred during the next flush
+	void Invalidate(const Region &region);
+	prosper::Texture *GetTexture(const Region &region) const;
+	Vector4 GetUvRect(const Region &region) const;
+	// Records the source rendering and blur passes for all invalidated pages
+	void Flush();
+private:
+	using SourceKey = std::pair<uint32_t,uint32_t>; // Position of the region within the page
+	struct Page
+	{
+		std::shared_ptr<prosper::RenderTarget> renderTarget = nullptr; // Atlas page containing the unblurred sources
+		std::shared_ptr<prosper::RenderTarget> blurredRenderTarget = nullptr;
+		std::shared_ptr<prosper::BlurSet> blurSet = nullptr;
+		std::map<SourceKey,std::pair<TextCacheAtlas::Region,RenderFunction>> sources = {};
+		std::set<SourceKey> dirtySources = {};
+		std::vector<std::array<uint32_t,4>> clearRects = {}; // Freed regions (x,y,w,h) including their padding
+		bool initialized = false; // The entire page has to be cleared before the first flush
+		bool dirty = false;
+	};
+	struct Layer
+	{
+		float blurSize = 0.f;
+		std::unique_ptr<TextCacheAtlas> atlas = nullptr;
+		std::vector<Page> pages = {};
+	};
+	Layer *FindLayer(float blurSize);
+	const Layer *FindLayer(float blurSize) const;
+	Page *FindPage(const Region &region);
+	bool InitializePage(Page &page,const std::shared_ptr<prosper::RenderTarget> &rt);
+	void ReleasePage(Page &page);
+	void FlushPage(Layer &layer,uint32_t pageIdx);
+	std::shared_ptr<prosper::IRenderPass> m_renderPass = nullptr;
+	std::vector<Layer> m_layers = {};
+	bool m_dirty = false;
+};
+
+#endif
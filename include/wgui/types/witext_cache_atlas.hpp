@@ -0,0 +1,78 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __WITEXT_CACHE_ATLAS_HPP__
+#define __WITEXT_CACHE_ATLAS_HPP__
+
+#include "wgui/wguidefinitions.h"
+#include <mathutil/uvec.h>
+#include <vector>
+#include <memory>
+#include <limits>
+
+namespace prosper {class RenderTarget; class IRenderPass; class ICommandBuffer; class IImage;};
+
+// Large R8 pages shared by all cached texts. Each cached text occupies a rectangular region
+// of a page, which is allocated with a shelf packer. Pages are released once their last region
+// has been freed, except for the last remaining page.
+class DLLWGUI TextCacheAtlas
+{
+public:
+	static constexpr uint32_t DEFAULT_PAGE_SIZE = 2'048u;
+	static constexpr uint32_t DEFAULT_REGION_PADDING = 1u; // Prevents neighboring regions from bleeding into each other when sampled
+	static constexpr uint32_t SHELF_HEIGHT_GRANULARITY = 8u;
+	struct DLLWGUI Region
+	{
+		uint32_t page = std::numeric_limits<uint32_t>::max();
+		uint32_t shelf = 0u;
+		uint32_t x = 0u;
+		uint32_t y = 0u;
+		uint32_t width = 0u;
+		uint32_t height = 0u;
+		uint32_t generation = 0u; // Atlas the region was allocated from, see TextCacheAtlas::IsValid
+		bool IsValid() const;
+	};
+	// Clears the specified rectangle of the image; Has to be called within a render pass the image is attached to
+	static void RecordClearRegion(prosper::ICommandBuffer &cmd,prosper::IImage &img,uint32_t x,uint32_t y,uint32_t width,uint32_t height);
+
+	TextCacheAtlas(prosper::IRenderPass &renderPass,uint32_t pageSize=DEFAULT_PAGE_SIZE,uint32_t regionPadding=DEFAULT_REGION_PADDING);
+	// Returns an invalid region if the size exceeds the page size
+	Region Allocate(uint32_t width,uint32_t height);
+	// Regions that weren't allocated from this atlas are only reset
+	void Free(Region &region);
+	// Returns false if the region is invalid or belongs to a different (e.g. previously destroyed) atlas
+	bool IsValid(const Region &region) const;
+	const std::shared_ptr<prosper::RenderTarget> &GetRenderTarget(const Region &region) const;
+	// Returns nullptr if the page has been released
+	const std::shared_ptr<prosper::RenderTarget> &GetPageRenderTarget(uint32_t pageIdx) const;
+	// Returns the uv coordinates of the region as (min x,min y,max x,max y)
+	Vector4 GetUvRect(const Region &region) const;
+	uint32_t GetPageCount() const;
+	uint32_t GetPageSize() const;
+	uint32_t GetRegionPadding() const;
+private:
+	struct Shelf
+	{
+		uint32_t y = 0u;
+		uint32_t height = 0u;
+		std::vector<std::pair<uint32_t,uint32_t>> freeSpans = {}; // Offset and width
+	};
+	struct Page
+	{
+		std::shared_ptr<prosper::RenderTarget> renderTarget = nullptr;
+		std::vector<Shelf> shelves = {};
+		uint32_t shelfEnd = 0u;
+		uint32_t regionCount = 0u;
+	};
+	bool AllocateInShelf(Shelf &shelf,uint32_t width,uint32_t &outX);
+	// Returns the index of the new page, or -1 on failure
+	int32_t AddPage();
+	std::shared_ptr<prosper::IRenderPass> m_renderPass = nullptr;
+	std::vector<Page> m_pages = {};
+	uint32_t m_pageSize = DEFAULT_PAGE_SIZE;
+	uint32_t m_regionPadding = DEFAULT_REGION_PADDING;
+	uint32_t m_generation = 0u;
+};
+
+#endif
@@ -0,0 +1,54 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __WITEXT_EDIT_HISTORY_HPP__
+#define __WITEXT_EDIT_HISTORY_HPP__
+
+#include "wgui/wguidefinitions.h"
+#include <util_formatted_text_types.hpp>
+#include <string_view>
+#include <vector>
+#include <string>
+
+// Undo/redo history of a text entry. Each edit only references the removed and inserted text, which is stored in
+// a single append-only buffer (similar to the add-buffer of a piece table), so recording an edit doesn't
+// copy or allocate anything but the edited characters themselves.
+class DLLWGUI TextEditHistory
+{
+public:
+	static constexpr size_t DEFAULT_MAX_BUFFER_SIZE = 16 *1'048'576; // 16 MiB
+	struct DLLWGUI Edit
+	{
+		util::text::TextOffset offset = 0;
+		// Ranges in the history buffer
+		size_t removedOffset = 0;
+		util::text::TextLength removedLength = 0;
+		size_t insertedOffset = 0;
+		util::text::TextLength insertedLength = 0;
+	};
+	void Clear();
+	// Oldest edits are discarded if the text of all edits exceeds this size
+	void SetMaxBufferSize(size_t size);
+	size_t GetMaxBufferSize() const;
+
+	// Records the replacement of 'removed' at the specified offset with 'inserted'. Any edits that have been undone
+	// are discarded. If 'merge' is true and the edit continues the insertion of the previous edit, both are merged,
+	// e.g. so that typing a word can be undone in one step.
+	void Record(util::text::TextOffset offset,const std::string_view &removed,const std::string_view &inserted,bool merge=false);
+	bool CanUndo() const;
+	bool CanRedo() const;
+	// Returns the edit that has to be reverted / re-applied, or nullptr if there is none
+	const Edit *Undo();
+	const Edit *Redo();
+	std::string_view GetRemovedText(const Edit &edit) const;
+	std::string_view GetInsertedText(const Edit &edit) const;
+private:
+	void Trim();
+	std::vector<Edit> m_edits = {};
+	size_t m_numApplied = 0; // Edits after this index have been undone
+	std::string m_buffer = {};
+	size_t m_maxBufferSize = DEFAULT_MAX_BUFFER_SIZE;
+};
+
+#endif
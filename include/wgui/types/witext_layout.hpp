@@ -0,0 +1,103 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __WITEXT_LAYOUT_HPP__
+#define __WITEXT_LAYOUT_HPP__
+
+#include "wgui/wguidefinitions.h"
+#include <util_formatted_text_types.hpp>
+#include <string_view>
+#include <vector>
+#include <cinttypes>
+
+// Immutable snapshot of the glyph metrics of a font. It doesn't reference the font or any GPU resources,
+// so it can be shared with (and outlive the font on) worker threads.
+class DLLWGUI FontMetrics
+{
+public:
+	struct DLLWGUI Glyph
+	{
+		int32_t advance = 0; // In pixels
+		int32_t left = 0;
+		int32_t top = 0;
+		int32_t width = 0;
+		int32_t height = 0;
+		bool valid = false;
+	};
+	// If monospaceAdvance is greater than 0, every character occupies a cell of that width (see IsMonospace)
+	FontMetrics(uint32_t size,uint32_t maxGlyphSize,char firstChar,std::vector<Glyph> &&glyphs,int32_t monospaceAdvance=0);
+	const Glyph *GetGlyph(char c) const;
+	uint32_t GetSize() const;
+	uint32_t GetMaxGlyphSize() const;
+	// Text of monospace fonts is measured by character counts instead of glyph advances. Characters without a glyph
+	// (i.e. control characters) don't occupy a cell, same as for proportional fonts.
+	bool IsMonospace() const;
+	int32_t GetMonospaceAdvance() const;
+private:
+	uint32_t m_size = 0u;
+	uint32_t m_maxGlyphSize = 0u;
+	int32_t m_monospaceAdvance = 0;
+	char m_firstChar = 0;
+	std::vector<Glyph> m_glyphs = {};
+};
+
+struct DLLWGUI TextLayout
+{
+	struct DLLWGUI Line
+	{
+		util::text::CharOffset startOffset = 0; // Relative to the start of the text
+		util::text::TextLength length = 0; // Excluding the new-line character
+		// Pixel offset of each character relative to the start of the line, followed by the width of the entire line
+		std::vector<int32_t> charPxOffsets = {};
+		// Character offsets following a whitespace character
+		std::vector<util::text::CharOffset> breakOffsets = {};
+		// Lengths of the sub-lines; Empty if the line isn't broken
+		std::vector<util::text::TextLength> subLines = {};
+		uint32_t GetSubLineCount() const;
+	};
+	std::vector<Line> lines = {};
+	int32_t width = 0;
+	int32_t height = 0;
+	uint32_t GetSubLineCount() const;
+};
+
+// Text measurement, line breaking and glyph positioning. All functions are pure and only depend on the arguments,
+// i.e. they can be used from any thread.
+class DLLWGUI TextLayoutEngine
+{
+public:
+	static constexpr uint32_t TAB_WIDTH_SPACE_COUNT = 4u;
+	enum class BreakMode : uint8_t
+	{
+		None = 0u,
+		Any,
+		Whitespace
+	};
+	struct DLLWGUI Options
+	{
+		BreakMode breakMode = BreakMode::None;
+		int32_t breakWidth = 0;
+		int32_t breakHeight = 0; // Additional spacing between lines
+		bool hidden = false; // Every character is measured as '*'
+	};
+
+	// Char offset (relative to a line) is required to calculate the correct tab size. Returns the number of character cells (i.e. including tab expansion).
+	static uint32_t MeasureText(const FontMetrics &metrics,const std::string_view &text,uint32_t charOffset,int32_t *width,int32_t *height=nullptr);
+	static void ComputeCharOffsets(
+		const FontMetrics &metrics,const std::string_view &line,bool hidden,
+		std::vector<int32_t> &outPxOffsets,std::vector<util::text::CharOffset> &outBreakOffsets
+	);
+	// Same as ComputeCharOffsets for monospace fonts, where every character with a glyph has the same advance
+	static void ComputeMonospaceCharOffsets(
+		const FontMetrics &metrics,const std::string_view &line,bool hidden,
+		std::vector<int32_t> &outPxOffsets,std::vector<util::text::CharOffset> &outBreakOffsets
+	);
+	static void BreakLine(
+		const std::vector<int32_t> &pxOffsets,const std::vector<util::text::CharOffset> &breakOffsets,
+		int32_t width,BreakMode breakMode,std::vector<util::text::TextLength> &outSubLines
+	);
+	static TextLayout Layout(const FontMetrics &metrics,const std::string_view &text,const Options &options={});
+};
+
+#endif
@@ -0,0 +1,44 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __WITEXT_LINE_OFFSET_TREE_HPP__
+#define __WITEXT_LINE_OFFSET_TREE_HPP__
+
+#include "wgui/wguidefinitions.h"
+#include <vector>
+#include <cinttypes>
+
+// Fenwick tree over the number of sub-lines of each line, used to look up the
+// sub-line offset of a line (and vice versa) in logarithmic time.
+// Inserting or erasing entries only invalidates the tree from that entry onwards,
+// the invalidated part is rebuilt lazily on the next query. Erasing the first entry
+// doesn't invalidate anything (e.g. for texts that are used as a log).
+class DLLWGUI TextLineOffsetTree
+{
+public:
+	void Clear();
+	// Replaces all entries; The tree is built lazily on the next query
+	void Assign(std::vector<uint32_t> &&values);
+	size_t GetSize() const;
+	void Insert(size_t index,uint32_t value);
+	void Erase(size_t index);
+	void Set(size_t index,uint32_t value);
+	uint32_t Get(size_t index) const;
+
+	// Returns the sum of all values before the specified index
+	uint32_t GetOffset(size_t index) const;
+	uint32_t GetTotal() const;
+	// Returns the index of the entry which contains the specified offset, or GetSize() if the offset is out of range
+	size_t FindIndex(uint32_t offset) const;
+private:
+	void Invalidate(size_t index);
+	void Update(size_t count) const;
+	uint32_t GetPhysicalOffset(size_t index) const;
+	std::vector<uint32_t> m_values = {}; // Includes the erased entries before m_start
+	size_t m_start = 0;
+	mutable std::vector<uint32_t> m_tree = {}; // One-based
+	mutable size_t m_validCount = 0;
+};
+
+#endif
@@ -10,11 +10,13 @@
 #include <mathutil/uvec.h>
 #include <sharedutils/util_shared_handle.hpp>
 #include <util_formatted_text_types.hpp>
+#include <sharedutils/util_event_reply.hpp>
+#include <iglfw/glfw_window.h>
 #include <functional>
 #include <optional>
+#include <memory>
 
 namespace util{namespace text{class TextTag; class FormattedTextLine; class AnchorPoint;};};
-namespace prosper {class IUniformResizableBuffer;};
 class WIText;
 struct DLLWGUI WITextTagArgument
 {
@@ -30,17 +32,42 @@ struct DLLWGUI WITextTagArgument
 };
 
 class DLLWGUI WITextDecorator
+	: public std::enable_shared_from_this<WITextDecorator>
 {
 public:
+	friend WIText;
+	// Decorations are rendered by the text element itself, see WIText::RenderDecorations
+	struct DLLWGUI Quad
+	{
+		enum class Layer : uint8_t
+		{
+			Background = 0u, // Rendered behind the glyphs
+			Foreground
+		};
+		// Relative to the text element. The vertical position includes the height of all lines that have been removed
+		// from the top of the text in log mode, so quads don't have to be updated when a line is removed.
+		Vector2i pos = {};
+		Vector2i size = {};
+		Vector4 color = {1.f,1.f,1.f,1.f};
+		Layer layer = Layer::Foreground;
+	};
 	WITextDecorator(WIText &text);
 	virtual ~WITextDecorator();
 	virtual void Clear();
 	virtual bool IsValid() const;
 
+	// Dirty decorators are queued in the text element and re-applied with the next tag update
 	void SetDirty(bool dirty=true);
 	bool IsDirty() const;
 
 	virtual bool IsTag() const;
+	const std::vector<Quad> &GetQuads() const;
+
+	// Interactive decorators are hit-tested by the text element using the character under the cursor
+	virtual bool IsInteractive() const;
+	virtual util::EventReply OnClicked();
+	virtual std::string GetTooltip() const;
+	virtual GLFW::Cursor::Shape GetCursor() const;
 
 	virtual void Initialize();
 	virtual void Apply();
@@ -65,14 +92,17 @@ public:
 		util::text::CharOffset &outTagStartOffsetInLine,util::text::CharOffset &outTagEndOffsetInLine
 	) const;
 protected:
-	void CreateOverlayElements();
-	void CreateOverlayElement(util::text::LineIndex lineIndex,util::text::TextOffset startOffset,util::text::TextOffset endOffset,std::vector<WIHandle> &cachedOverlays);
-	virtual void CalcBounds(Vector2i &inOutPos,Vector2i &inOutSize);
-	virtual void InitializeOverlay(WIBase &overlay);
+	// Calls AddQuads for the bounds of each sub-line spanned by the decorator
+	void UpdateQuads();
+	virtual void AddQuads(const Vector2i &pos,const Vector2i &size,std::vector<Quad> &outQuads);
+	// Has to be called if the start or end offset has been moved, other than by an edit of the text
+	void OnRangeChanged();
 
-	std::vector<WIHandle> m_overlays = {};
+	std::vector<Quad> m_quads = {};
 	bool m_bDirty = false;
 	WIText &m_text;
+private:
+	std::optional<util::text::LineIndex> m_lineSpan = {}; // Number of lines spanned when the decorator was last applied
 };
 
 class DLLWGUI WITextTag
@@ -103,8 +133,7 @@ public:
 	using WITextTag::WITextTag;
 	virtual void Apply() override;
 protected:
-	virtual void InitializeOverlay(WIBase &overlay) override;
-	virtual void CalcBounds(Vector2i &inOutPos,Vector2i &inOutSize) override;
+	virtual void AddQuads(const Vector2i &pos,const Vector2i &size,std::vector<Quad> &outQuads) override;
 	Color m_underlineColor;
 };
 
@@ -112,14 +141,10 @@ class DLLWGUI WITextTagColor
 	: public WITextTag
 {
 public:
-	static void ClearColorBuffer();
-
 	using WITextTag::WITextTag;
 	virtual void Apply() override;
 
 	std::optional<Vector4> GetColor() const;
-private:
-	static std::shared_ptr<prosper::IUniformResizableBuffer> s_colorBuffer;
 };
 
 class DLLWGUI WITextTagTooltip
@@ -127,9 +152,8 @@ class DLLWGUI WITextTagTooltip
 {
 public:
 	using WITextTag::WITextTag;
-	virtual void Apply() override;
-protected:
-	virtual void InitializeOverlay(WIBase &overlay) override;
+	virtual bool IsInteractive() const override;
+	virtual std::string GetTooltip() const override;
 };
 
 class DLLWGUI WITextTagLink
@@ -140,9 +164,10 @@ public:
 
 	using WITextTagUnderline::WITextTagUnderline;
 	virtual void Initialize() override;
-	virtual void Apply() override;
+	virtual bool IsInteractive() const override;
+	virtual util::EventReply OnClicked() override;
+	virtual GLFW::Cursor::Shape GetCursor() const override;
 protected:
-	virtual void InitializeOverlay(WIBase &overlay) override;
 	CallbackHandle m_cbFunction = {};
 	std::vector<std::string> m_strArgs = {};
 private:
@@ -161,9 +186,9 @@ public:
 	
 	void SetStartOffset(util::text::TextOffset offset);
 	void SetEndOffset(util::text::TextOffset offset);
+	void SetRange(util::text::TextOffset startOffset,util::text::TextOffset endOffset);
 protected:
-	virtual void InitializeOverlay(WIBase &overlay) override;
-	virtual void CalcBounds(Vector2i &inOutPos,Vector2i &inOutSize) override;
+	virtual void AddQuads(const Vector2i &pos,const Vector2i &size,std::vector<Quad> &outQuads) override;
 	std::optional<std::pair<util::text::LineIndex,util::text::CharOffset>> GetAbsOffset(util::text::TextOffset offset) const;
 	util::TSharedHandle<util::text::AnchorPoint> m_startAnchorPoint = nullptr;
 	util::TSharedHandle<util::text::AnchorPoint> m_endAnchorPoint = nullptr;
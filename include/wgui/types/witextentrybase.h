@@ -6,6 +6,7 @@
 #define __WITEXTENTRYBASE_H__
 #include "wgui/wibase.h"
 #include "wgui/wihandle.h"
+#include "wgui/types/witext_edit_history.hpp"
 #include <util_formatted_text_types.hpp>
 #include <string_view>
 
@@ -64,6 +65,9 @@ public:
 	void SetSelectionBounds(int start,int end);
 	void ClearSelection();
 	bool RemoveSelectedText();
+	bool Undo();
+	bool Redo();
+	TextEditHistory &GetEditHistory();
 	void OnEnter();
 	void SetMaxLength(int length);
 	int GetMaxLength();
@@ -79,6 +83,7 @@ protected:
 	int m_selectStart;
 	int m_selectEnd;
 	bool m_bWasDoubleClick = false;
+	TextEditHistory m_editHistory = {};
 	int GetCharPos(int x,int y) const;
 	int GetCharPos() const;
 	int GetLineFromPos(int pos);
@@ -87,6 +92,9 @@ protected:
 	void UpdateSelection();
 	std::pair<util::text::LineIndex,util::text::LineIndex> GetLineInfo(int pos,std::string_view &outLine,int *lpos) const;
 	void UpdateTextPosition();
+	void InsertText(const std::string_view &instext,int pos,bool mergeEdit);
+	// Replaces 'len' characters at the specified offset (relative to the formatted text) without recording the edit
+	void ApplyEdit(int offset,int len,const std::string_view &text);
 	virtual void OnTextChanged(const std::string &text,bool changedByUser);
 	void OnTextChanged(bool changedByUser);
 };
@@ -21,6 +21,8 @@
 class WIBase;
 class WISkin;
 class WIHandle;
+class TextBatcher;
+class UploadManager;
 namespace GLFW {class Joystick;};
 namespace prosper
 {
@@ -38,7 +40,8 @@ namespace wgui
 	class ShaderColoredLine;
 	class ShaderText;
 	class ShaderTextRect;
-	class ShaderTextRectColor;
+	using ShaderTextRectColor = ShaderTextRect; // Deprecated, see GetTextRectColorShader
+	class ShaderTextBatch;
 	class ShaderTextured;
 	class ShaderTexturedRect;
 };
@@ -96,6 +99,16 @@ public:
 	WIBase *FindByIndex(uint64_t index) const;
 	void Think();
 	void Draw();
+	// Position and size changes within a layout transaction don't update anything that depends on them (anchors,
+	// attachments, auto-sizing and the "SetPos"/"SetSize" callbacks) right away. Instead, every affected element is
+	// updated once, parents before children, by the layout pass at the beginning of the next Think or Draw.
+	// Elements that are auto-sized to their contents are resized once per pass, after all of their children.
+	// Transactions can be nested. Note that the geometry of dependent elements isn't up-to-date until the layout pass,
+	// UpdateLayout can be used to run it early.
+	void BeginLayoutTransaction();
+	void EndLayoutTransaction();
+	bool IsLayoutTransactionActive() const;
+	void UpdateLayout();
 	bool HandleJoystickInput(GLFW::Window &window,const GLFW::Joystick &joystick,uint32_t key,GLFW::KeyState state);
 	bool HandleMouseInput(GLFW::Window &window,GLFW::MouseButton button,GLFW::KeyState state,GLFW::Modifier mods);
 	bool HandleKeyboardInput(GLFW::Window &window,GLFW::Key key,int scanCode,GLFW::KeyState state,GLFW::Modifier mods);
@@ -131,14 +144,25 @@ public:
 	wgui::ShaderColoredLine *GetColoredLineShader();
 	wgui::ShaderText *GetTextShader();
 	wgui::ShaderTextRect *GetTextRectShader();
+	// Deprecated: Glyph colors are part of the glyph instances now, so colored text is rendered with the regular text rect shader
 	wgui::ShaderTextRectColor *GetTextRectColorShader();
+	wgui::ShaderTextBatch *GetTextBatchShader();
 	wgui::ShaderTextured *GetTexturedShader();
 	wgui::ShaderTexturedRect *GetTexturedRectShader();
 
 	void GetScissor(uint32_t &x,uint32_t &y,uint32_t &w,uint32_t &h);
 	void SetScissor(uint32_t x,uint32_t y,uint32_t w,uint32_t h);
+
+	// Only available during Draw
+	TextBatcher *GetTextBatcher();
+	// Has to be called before anything is rendered during Draw with a shader that isn't a wgui shader
+	void FlushTextBatch();
+	// Buffer updates scheduled with the upload manager are recorded at the end of Think
+	UploadManager &GetUploadManager();
 private:
 	void ScheduleElementForUpdate(WIBase &el);
+	void ScheduleElementForLayout(WIBase &el);
+	void ScheduleElementForAutoSize(WIBase &el);
 	friend WIBase;
 	friend wgui::Shader;
 	friend wgui::ShaderColoredRect;
@@ -158,6 +182,10 @@ private:
 	std::vector<WIHandle> m_thinkingElements;
 
 	std::vector<WIHandle> m_updateQueue;
+	std::vector<WIHandle> m_layoutQueue; // Elements with pending geometry changes, see BeginLayoutTransaction
+	std::vector<WIHandle> m_autoSizeQueue; // Elements that have to be auto-sized to their contents during the current layout pass
+	uint32_t m_layoutTransactionDepth = 0u;
+	bool m_layoutPassActive = false;
 	std::queue<WIHandle> m_removeQueue;
 	std::function<std::shared_ptr<WIHandle>(WIBase&)> m_handleFactory = nullptr;
 	std::vector<std::unique_ptr<GLFW::Cursor>> m_cursors;
@@ -169,13 +197,15 @@ private:
 	ChronoTime m_time = {};
 	double m_tLastThink = 0;
 	double m_tDelta = 0.f;
+	std::unique_ptr<TextBatcher> m_textBatcher = nullptr;
+	std::unique_ptr<UploadManager> m_uploadManager = nullptr;
 
 	util::WeakHandle<prosper::Shader> m_shaderColored = {};
 	util::WeakHandle<prosper::Shader> m_shaderColoredCheap = {};
 	util::WeakHandle<prosper::Shader> m_shaderColoredLine = {};
 	util::WeakHandle<prosper::Shader> m_shaderText = {};
 	util::WeakHandle<prosper::Shader> m_shaderTextCheap = {};
-	util::WeakHandle<prosper::Shader> m_shaderTextCheapColor = {};
+	util::WeakHandle<prosper::Shader> m_shaderTextBatch = {};
 	util::WeakHandle<prosper::Shader> m_shaderTextured = {};
 	util::WeakHandle<prosper::Shader> m_shaderTexturedCheap = {};
 
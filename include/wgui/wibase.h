@@ -77,7 +77,13 @@ public:
 		AutoSizeToContentsY = AutoSizeToContentsX<<1u,
 		IsBeingRemoved = AutoSizeToContentsY<<1u,
 		IsBeingUpdated = IsBeingRemoved<<1u,
-		IsBackgroundElement = IsBeingUpdated<<1u
+		IsBackgroundElement = IsBeingUpdated<<1u,
+		// Geometry has changed during a layout transaction, see WGUI::BeginLayoutTransaction
+		LayoutPosPending = IsBackgroundElement<<1u,
+		LayoutSizePending = LayoutPosPending<<1u,
+		// The contents have changed during the layout pass, auto-sizing is resolved once all geometry changes have been applied
+		LayoutAutoSizeXPending = LayoutSizePending<<1u,
+		LayoutAutoSizeYPending = LayoutAutoSizeXPending<<1u
 	};
 	struct DLLWGUI DrawInfo
 	{
@@ -379,6 +385,13 @@ protected:
 	bool ShouldThink() const;
 private:
 	void UpdateThink();
+	void ScheduleLayoutUpdate(StateFlags flag);
+	void ResolveLayout();
+	void ScheduleAutoSizeToContents(bool updateX,bool updateY);
+	void ResolveAutoSizeToContents();
+	// Updates everything that depends on the position/size of this element (attachments, anchors, children, auto-sizing)
+	void ApplyPosChange();
+	void ApplySizeChange();
 	WIBase *FindDeepestChild(const std::function<bool(const WIBase&)> &predInspect,const std::function<bool(const WIBase&)> &predValidCandidate);
 	util::PVector2iProperty m_pos = nullptr;
 	util::PVector2iProperty m_size = nullptr;
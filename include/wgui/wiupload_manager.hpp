@@ -0,0 +1,63 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __WIUPLOAD_MANAGER_HPP__
+#define __WIUPLOAD_MANAGER_HPP__
+
+#include "wguidefinitions.h"
+#include <buffers/prosper_buffer.hpp>
+#include <vector>
+#include <memory>
+#include <limits>
+
+// Collects all GPU buffer updates of the GUI during a frame (e.g. glyph instances of text elements). The data is written
+// directly into persistently mapped staging chunks, Flush only records one copy per contiguous destination range and one
+// barrier per destination buffer.
+class DLLWGUI UploadManager
+{
+public:
+	static constexpr prosper::DeviceSize STAGING_CHUNK_SIZE = 1'048'576; // 1 MiB, larger requests get a dedicated chunk
+	static constexpr prosper::DeviceSize STAGING_MAX_SIZE = STAGING_CHUNK_SIZE *32u;
+
+	~UploadManager();
+	// Returns a pointer the caller has to write 'size' bytes of data to. The pointer is only valid until the next call to
+	// any of the UploadManager functions. Updates of the same buffer must not overlap within a frame.
+	void *ScheduleUpdate(const std::shared_ptr<prosper::IBuffer> &buffer,prosper::DeviceSize offset,prosper::DeviceSize size);
+	void ScheduleUpdate(const std::shared_ptr<prosper::IBuffer> &buffer,prosper::DeviceSize offset,prosper::DeviceSize size,const void *data);
+	// Allocates host-coherent memory that can be read by the GPU directly (as vertex or storage buffer) during the current
+	// frame, without any transfer. Since no commands have to be recorded, this can also be used inside of a render pass.
+	// Returns nullptr if the staging memory is exhausted.
+	void *AllocateFrameData(prosper::DeviceSize size,prosper::DeviceSize alignment,std::shared_ptr<prosper::IBuffer> &outBuffer,prosper::DeviceSize &outOffset);
+	// Records all scheduled updates. Has to be called outside of a render pass.
+	void Flush();
+	bool IsEmpty() const;
+	void Clear();
+private:
+	struct StagingChunk
+	{
+		std::shared_ptr<prosper::IBuffer> buffer = nullptr;
+		uint8_t *data = nullptr; // Persistently mapped
+		prosper::DeviceSize size = 0;
+		prosper::DeviceSize offset = 0;
+		uint64_t lastFrameId = std::numeric_limits<uint64_t>::max(); // Last frame the chunk has been kept alive for
+		uint32_t numPendingUpdates = 0; // Updates that have not been flushed yet
+	};
+	struct Update
+	{
+		std::shared_ptr<prosper::IBuffer> buffer = nullptr;
+		prosper::IBuffer *rootBuffer = nullptr; // Buffer that owns the memory, if 'buffer' is a sub-buffer
+		prosper::DeviceSize dstOffset = 0; // Relative to the root buffer
+		prosper::DeviceSize size = 0;
+		uint32_t chunkIndex = 0;
+		prosper::DeviceSize srcOffset = 0; // Offset into the staging chunk
+	};
+	// Returns the index of the chunk the data was allocated in, or -1 if the staging memory is exhausted
+	int32_t Allocate(prosper::DeviceSize size,prosper::DeviceSize alignment,prosper::DeviceSize &outOffset);
+	void KeepChunkAlive(StagingChunk &chunk);
+	std::vector<Update> m_updates = {};
+	std::vector<StagingChunk> m_chunks = {};
+	uint32_t m_currentChunk = std::numeric_limits<uint32_t>::max();
+};
+
+#endif
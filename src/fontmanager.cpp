@@ -109,7 +109,7 @@ const GlyphInfo *FontInfo::GetGlyphInfo(char c) const
 const std::vector<std::shared_ptr<GlyphInfo>> &FontInfo::GetGlyphs() const {return m_glyphs;}
 uint32_t FontInfo::GetSize() const {return m_size;}
 
-bool FontInfo::Initialize(const std::string &cpath,uint32_t fontSize)
+bool FontInfo::Initialize(const std::string &cpath,uint32_t fontSize,std::optional<bool> monospace)
 {
 	if(m_bInitialized || wgui::ShaderText::DESCRIPTOR_SET_TEXTURE.IsValid() == false)
 		return true;
@@ -299,6 +299,39 @@ bool FontInfo::Initialize(const std::string &cpath,uint32_t fontSize)
 	m_maxGlyphHeight = hMax;
 	m_bInitialized = true;
 
+	std::vector<FontMetrics::Glyph> metricsGlyphs(m_glyphs.size());
+	for(auto i=decltype(m_glyphs.size()){0};i<m_glyphs.size();++i)
+	{
+		auto &glyph = m_glyphs[i];
+		if(glyph == nullptr)
+			continue;
+		auto &metricsGlyph = metricsGlyphs.at(i);
+		int32_t advanceX,advanceY;
+		glyph->GetAdvance(advanceX,advanceY);
+		glyph->GetDimensions(metricsGlyph.left,metricsGlyph.top,metricsGlyph.width,metricsGlyph.height);
+		metricsGlyph.advance = advanceX >> 6;
+		metricsGlyph.valid = true;
+	}
+	// All cells of fixed-width fonts have the advance of the space character. Some fonts claim to be fixed-width
+	// without actually being so, so the advance is checked against a few other glyphs as well.
+	int32_t monospaceAdvance = 0;
+	if((monospace.has_value() ? *monospace : FT_IS_FIXED_WIDTH(face)) && metricsGlyphs.empty() == false && metricsGlyphs.front().valid)
+	{
+		monospaceAdvance = metricsGlyphs.front().advance;
+		for(auto c : {'M','i','0','W','.'})
+		{
+			auto idx = static_cast<uint32_t>(c) -umath::to_integral(GlyphRange::Start);
+			if(idx >= metricsGlyphs.size() || metricsGlyphs[idx].valid == false)
+				continue;
+			if(metricsGlyphs[idx].advance != monospaceAdvance)
+			{
+				monospaceAdvance = 0;
+				break;
+			}
+		}
+	}
+	m_metrics = std::make_shared<FontMetrics>(m_size,m_maxGlyphSize,static_cast<char>(umath::to_integral(GlyphRange::Start)),std::move(metricsGlyphs),monospaceAdvance);
+
 	auto wpShader = context.GetShader("wguitext");
 	if(wpShader.expired() == false)
 	{
@@ -314,6 +347,8 @@ uint32_t FontInfo::CharToGlyphMapIndex(char c) {return static_cast<uint8_t>(c) -
 
 std::shared_ptr<prosper::Texture> FontInfo::GetGlyphMap() const {return m_glyphMap;}
 std::shared_ptr<prosper::IBuffer> FontInfo::GetGlyphBoundsBuffer() const {return m_glyphBoundsBuffer;}
+const std::shared_ptr<const FontMetrics> &FontInfo::GetMetrics() const {return m_metrics;}
+bool FontInfo::IsMonospace() const {return m_metrics != nullptr && m_metrics->IsMonospace();}
 prosper::IDescriptorSet *FontInfo::GetGlyphBoundsDescriptorSet() const
 {
 	return m_glyphBoundsDsg ? m_glyphBoundsDsg->GetDescriptorSet() : nullptr;
@@ -335,6 +370,8 @@ void FontInfo::Clear()
 	m_maxGlyphSize = 0;
 	m_maxGlyphHeight = 0;
 	m_size = 0;
+	// Existing layouts may still hold on to the snapshot, so it is only released, not cleared
+	m_metrics = nullptr;
 	m_bInitialized = false;
 }
 
@@ -365,7 +402,7 @@ std::shared_ptr<const FontInfo> FontManager::GetFont(const std::string &cfontNam
 	return it->second;
 }
 
-std::shared_ptr<const FontInfo> FontManager::LoadFont(const std::string &cidentifier,const std::string &cpath,uint32_t size,bool bForceReload)
+std::shared_ptr<const FontInfo> FontManager::LoadFont(const std::string &cidentifier,const std::string &cpath,uint32_t size,bool bForceReload,std::optional<bool> monospace)
 {
 	auto &lib = m_lib.GetFtLibrary();
 	if(lib == nullptr)
@@ -396,7 +433,7 @@ std::shared_ptr<const FontInfo> FontManager::LoadFont(const std::string &cidenti
 	}
 	if(font == nullptr)
 		font = std::shared_ptr<FontInfo>(new FontInfo());
-	if(!font->Initialize(path.c_str(),size))
+	if(!font->Initialize(path.c_str(),size,monospace))
 		return nullptr;
 	m_fonts.insert(decltype(m_fonts)::value_type(identifier,font));
 	return font;
@@ -430,7 +467,7 @@ void FontManager::Close()
 }
 uint32_t FontManager::GetTextSize(const std::string_view &text,uint32_t charOffset,const FontInfo *font,int32_t *width,int32_t *height)
 {
-	if(font == nullptr)
+	if(font == nullptr || font->GetMetrics() == nullptr)
 	{
 		if(width != nullptr)
 			*width = 0;
@@ -438,65 +475,15 @@ uint32_t FontManager::GetTextSize(const std::string_view &text,uint32_t charOffs
 			*height = 0;
 		return 0;
 	}
-	auto fWidth = 0.f;
-	auto fHeight = 0.f;
-	int32_t scrW,scrH;
-
-	auto &context = WGUI::GetInstance().GetContext();
-	scrW = context.GetWindowWidth();
-	scrH = context.GetWindowHeight();
-	auto sx = 2.f /static_cast<float>(scrW);
-	auto sy = 2.f /static_cast<float>(scrH);
-	auto offset = charOffset;
-	for(auto c : text)
-	{
-		auto multiplier = 1u;
-		if(c == '\t')
-		{
-			c = ' ';
-			auto tabSpaceCount = TAB_WIDTH_SPACE_COUNT -(offset %TAB_WIDTH_SPACE_COUNT);
-			multiplier = tabSpaceCount;
-		}
-		auto *glyph = font->GetGlyphInfo(c);
-		if(glyph != nullptr)
-		{
-			int32_t advanceX,advanceY;
-			glyph->GetAdvance(advanceX,advanceY);
-
-			int32_t left,top,width,height;
-			glyph->GetDimensions(left,top,width,height);
-			width *= multiplier;
-			auto fadvanceX = static_cast<float>(advanceX >> 6) *multiplier;
-			auto fadvanceY = static_cast<float>(height);
-			fadvanceX *= sx;
-			fadvanceY *= sy;
-			fWidth += fadvanceX;
-			if(fadvanceY > fHeight)
-				fHeight = fadvanceY;
-			offset += multiplier;
-		}
-		if(c == '\n')
-			offset = 0u;
-	}
-	fWidth *= 0.5f;
-	fHeight *= 0.5f;
-	fWidth *= scrW;
-	fHeight *= scrH;
-	if(width != nullptr)
-		*width = static_cast<int32_t>(fWidth);
-	if(height != nullptr)
-		*height = static_cast<int32_t>(fHeight);
-	return offset -charOffset;
+	return TextLayoutEngine::MeasureText(*font->GetMetrics(),text,charOffset,width,height);
 }
 
 uint32_t FontManager::GetTextSize(const std::string_view &text,uint32_t charOffset,const std::string &font,int32_t *width,int32_t *height) {return  GetTextSize(text,charOffset,GetFont(font).get(),width,height);}
 uint32_t FontManager::GetTextSize(char c,uint32_t charOffset,const FontInfo *font,int32_t *width,int32_t *height)
 {
-	std::string str{c,'\0'};
-	return GetTextSize(str,charOffset,font,width,height);
+	return GetTextSize(std::string_view{&c,1},charOffset,font,width,height);
 }
 uint32_t FontManager::GetTextSize(char c,uint32_t charOffset,const std::string &font,int32_t *width,int32_t *height)
 {
-	std::string str{c,'\0'};
-	return GetTextSize(str,charOffset,font,width,height);
+	return GetTextSize(std::string_view{&c,1},charOffset,font,width,height);
 }
@@ -4,6 +4,7 @@
 
 #include "stdafx_wgui.h"
 #include "wgui/shaders/wishader.hpp"
+#include "wgui/shaders/wishader_text.hpp"
 #include <shader/prosper_pipeline_create_info.hpp>
 #include <prosper_util_square_shape.hpp>
 #include <prosper_context.hpp>
@@ -41,6 +42,10 @@ size_t Shader::GetBaseTypeHashCode() const {return typeid(Shader).hash_code();}
 
 bool Shader::BeginDraw(const std::shared_ptr<prosper::IPrimaryCommandBuffer> &cmdBuffer,uint32_t width,uint32_t height,uint32_t pipelineIdx)
 {
+	// Batched text has to be rendered first to retain the draw order
+	auto &gui = WGUI::GetInstance();
+	if(this != gui.GetTextBatchShader())
+		gui.FlushTextBatch();
 	if(ShaderGraphics::BeginDraw(cmdBuffer,pipelineIdx,RecordFlags::None) == false || cmdBuffer->RecordSetViewport(width,height) == false)
 		return false;
 	uint32_t x,y,w,h;
@@ -18,8 +18,10 @@ decltype(ShaderText::VERTEX_ATTRIBUTE_POSITION) ShaderText::VERTEX_ATTRIBUTE_POS
 decltype(ShaderText::VERTEX_ATTRIBUTE_UV) ShaderText::VERTEX_ATTRIBUTE_UV = {VERTEX_BINDING_VERTEX,prosper::util::get_square_uv_format()};
 
 decltype(ShaderText::VERTEX_BINDING_GLYPH) ShaderText::VERTEX_BINDING_GLYPH = {prosper::VertexInputRate::Instance};
-decltype(ShaderText::VERTEX_ATTRIBUTE_GLYPH_INDEX) ShaderText::VERTEX_ATTRIBUTE_GLYPH_INDEX = {VERTEX_BINDING_GLYPH,prosper::Format::R32_UInt};
-decltype(ShaderText::VERTEX_ATTRIBUTE_GLYPH_BOUNDS) ShaderText::VERTEX_ATTRIBUTE_GLYPH_BOUNDS = {VERTEX_BINDING_GLYPH,prosper::Format::R32G32B32A32_SFloat};
+decltype(ShaderText::VERTEX_ATTRIBUTE_GLYPH_INDEX) ShaderText::VERTEX_ATTRIBUTE_GLYPH_INDEX = {VERTEX_BINDING_GLYPH,prosper::Format::R16_UInt};
+decltype(ShaderText::VERTEX_ATTRIBUTE_GLYPH_FLAGS) ShaderText::VERTEX_ATTRIBUTE_GLYPH_FLAGS = {VERTEX_BINDING_GLYPH,prosper::Format::R16_UInt};
+decltype(ShaderText::VERTEX_ATTRIBUTE_GLYPH_POSITION) ShaderText::VERTEX_ATTRIBUTE_GLYPH_POSITION = {VERTEX_BINDING_GLYPH,prosper::Format::R32G32_UInt};
+decltype(ShaderText::VERTEX_ATTRIBUTE_GLYPH_COLOR) ShaderText::VERTEX_ATTRIBUTE_GLYPH_COLOR = {VERTEX_BINDING_GLYPH,prosper::Format::R8G8B8A8_UNorm};
 
 decltype(ShaderText::DESCRIPTOR_SET_TEXTURE) ShaderText::DESCRIPTOR_SET_TEXTURE = {
 	{
@@ -32,8 +34,8 @@ decltype(ShaderText::DESCRIPTOR_SET_TEXTURE) ShaderText::DESCRIPTOR_SET_TEXTURE
 decltype(ShaderText::DESCRIPTOR_SET_GLYPH_BOUNDS_BUFFER) ShaderText::DESCRIPTOR_SET_GLYPH_BOUNDS_BUFFER = {
 	{
 		prosper::DescriptorSetInfo::Binding {
-		prosper::DescriptorType::UniformBuffer,
-		prosper::ShaderStageFlags::VertexBit
+			prosper::DescriptorType::StorageBuffer,
+			prosper::ShaderStageFlags::VertexBit
 		}
 	}
 };
@@ -45,10 +47,16 @@ ShaderText::ShaderText(prosper::IPrContext &context,const std::string &identifie
 	: Shader(context,identifier,vsShader,fsShader,gsShader)
 {}
 
+uint32_t ShaderText::PackLineMetrics(uint32_t lineHeight,uint32_t fontSize)
+{
+	return umath::min(lineHeight,static_cast<uint32_t>(std::numeric_limits<uint16_t>::max())) | (umath::min(fontSize,static_cast<uint32_t>(std::numeric_limits<uint16_t>::max())) <<16u);
+}
+
 void ShaderText::InitializeRenderPass(std::shared_ptr<prosper::IRenderPass> &outRenderPass,uint32_t pipelineIdx)
 {
+	// Contents have to be retained, since cached texts only render into their own region of the target image
 	CreateCachedRenderPass<ShaderText>({{{
-		prosper::Format::R8_UNorm,prosper::ImageLayout::ColorAttachmentOptimal,prosper::AttachmentLoadOp::DontCare,
+		prosper::Format::R8_UNorm,prosper::ImageLayout::ColorAttachmentOptimal,prosper::AttachmentLoadOp::Load,
 		prosper::AttachmentStoreOp::Store,prosper::SampleCountFlags::e1Bit,prosper::ImageLayout::ShaderReadOnlyOptimal
 	}}},outRenderPass,pipelineIdx);
 }
@@ -60,23 +68,25 @@ void ShaderText::InitializeGfxPipeline(prosper::GraphicsPipelineCreateInfo &pipe
 	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_POSITION);
 	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_UV);
 	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_INDEX);
-	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_BOUNDS);
+	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_FLAGS);
+	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_POSITION);
+	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_COLOR);
 	AddDescriptorSetGroup(pipelineInfo,DESCRIPTOR_SET_TEXTURE);
 	AddDescriptorSetGroup(pipelineInfo,DESCRIPTOR_SET_GLYPH_BOUNDS_BUFFER);
 	AttachPushConstantRange(pipelineInfo,0u,sizeof(PushConstants),prosper::ShaderStageFlags::VertexBit);
 }
 
 bool ShaderText::Draw(
-	prosper::IBuffer &glyphBoundsIndexBuffer,
-	prosper::IDescriptorSet &descTextureSet,const PushConstants &pushConstants,
+	prosper::IBuffer &glyphBuffer,
+	prosper::IDescriptorSet &descTextureSet,prosper::IDescriptorSet &descGlyphBoundsSet,const PushConstants &pushConstants,
 	uint32_t instanceCount
 )
 {
 	if(
 		RecordBindVertexBuffers({
-			prosper::util::get_square_vertex_uv_buffer(GetContext()).get(),&glyphBoundsIndexBuffer
+			prosper::util::get_square_vertex_uv_buffer(GetContext()).get(),&glyphBuffer
 		}) == false ||
-		RecordBindDescriptorSets({&descTextureSet}) == false ||
+		RecordBindDescriptorSets({&descTextureSet,&descGlyphBoundsSet}) == false ||
 		RecordPushConstants(pushConstants) == false ||
 		RecordDraw(prosper::util::get_square_vertex_count(),instanceCount) == false
 	)
@@ -86,6 +96,14 @@ bool ShaderText::Draw(
 
 ///////////////////////
 
+decltype(ShaderTextRect::DESCRIPTOR_SET_GLYPH_BLOCK_ORIGIN_BUFFER) ShaderTextRect::DESCRIPTOR_SET_GLYPH_BLOCK_ORIGIN_BUFFER = {
+	{
+		prosper::DescriptorSetInfo::Binding {
+			prosper::DescriptorType::StorageBuffer,
+			prosper::ShaderStageFlags::VertexBit
+		}
+	}
+};
 ShaderTextRect::ShaderTextRect(prosper::IPrContext &context,const std::string &identifier)
 	: ShaderText(context,identifier,"wgui/vs_wgui_text_cheap","wgui/fs_wgui_text_cheap")
 {}
@@ -93,21 +111,50 @@ ShaderTextRect::ShaderTextRect(prosper::IPrContext &context,const std::string &i
 	: ShaderText(context,identifier,vsShader,fsShader,gsShader)
 {}
 
+void ShaderTextRect::SetSinglePassEffectsSupported(bool supported) {m_singlePassEffectsSupported = supported;}
+bool ShaderTextRect::AreSinglePassEffectsSupported() const {return m_singlePassEffectsSupported;}
+
+uint32_t ShaderTextRect::PackColor(const Vector4 &color)
+{
+	const auto fToUnorm = [](float f) -> uint32_t {return static_cast<uint32_t>(umath::round(umath::clamp(f,0.f,1.f) *255.f));};
+	return fToUnorm(color.r) | (fToUnorm(color.g) <<8u) | (fToUnorm(color.b) <<16u) | (fToUnorm(color.a) <<24u);
+}
+uint32_t ShaderTextRect::PackOffset(const Vector2i &offset)
+{
+	auto x = static_cast<uint16_t>(static_cast<int16_t>(umath::clamp(offset.x,-32'768,32'767)));
+	auto y = static_cast<uint16_t>(static_cast<int16_t>(umath::clamp(offset.y,-32'768,32'767)));
+	return static_cast<uint32_t>(x) | (static_cast<uint32_t>(y) <<16u);
+}
+
 bool ShaderTextRect::Draw(
-	prosper::IBuffer &glyphBoundsIndexBuffer,
-	prosper::IDescriptorSet &descTextureSet,const PushConstants &pushConstants,
-	uint32_t instanceCount
+	prosper::IBuffer &glyphBuffer,
+	prosper::IDescriptorSet &descTextureSet,prosper::IDescriptorSet &descGlyphBoundsSet,prosper::IDescriptorSet &descGlyphBlockOriginSet,
+	const PushConstants &pushConstants,uint32_t instanceCount
+)
+{
+	return Draw(glyphBuffer,descTextureSet,descGlyphBoundsSet,descGlyphBlockOriginSet,pushConstants,{{0u,instanceCount}});
+}
+bool ShaderTextRect::Draw(
+	prosper::IBuffer &glyphBuffer,
+	prosper::IDescriptorSet &descTextureSet,prosper::IDescriptorSet &descGlyphBoundsSet,prosper::IDescriptorSet &descGlyphBlockOriginSet,
+	const PushConstants &pushConstants,const std::vector<std::pair<uint32_t,uint32_t>> &instanceRanges
 )
 {
 	if(
 		RecordBindVertexBuffers({
-			prosper::util::get_square_vertex_uv_buffer(GetContext()).get(),&glyphBoundsIndexBuffer
+			prosper::util::get_square_vertex_uv_buffer(GetContext()).get(),&glyphBuffer
 			}) == false ||
-		RecordBindDescriptorSets({&descTextureSet}) == false ||
-		RecordPushConstants(pushConstants) == false ||
-		RecordDraw(prosper::util::get_square_vertex_count(),instanceCount) == false
+		RecordBindDescriptorSets({&descTextureSet,&descGlyphBoundsSet,&descGlyphBlockOriginSet}) == false ||
+		RecordPushConstants(pushConstants) == false
 	)
 		return false;
+	// The block origins are looked up through gl_InstanceIndex, which includes the first instance
+	auto vertexCount = prosper::util::get_square_vertex_count();
+	for(auto &range : instanceRanges)
+	{
+		if(RecordDraw(vertexCount,range.second,0u,range.first) == false)
+			return false;
+	}
 	return true;
 }
 
@@ -127,32 +174,76 @@ void ShaderTextRect::InitializeGfxPipeline(prosper::GraphicsPipelineCreateInfo &
 	AddVertexAttribute(pipelineInfo,ShaderText::VERTEX_ATTRIBUTE_POSITION);
 	AddVertexAttribute(pipelineInfo,ShaderText::VERTEX_ATTRIBUTE_UV);
 	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_INDEX);
-	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_BOUNDS);
+	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_FLAGS);
+	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_POSITION);
+	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_COLOR);
 	AddDescriptorSetGroup(pipelineInfo,ShaderText::DESCRIPTOR_SET_TEXTURE);
 	AddDescriptorSetGroup(pipelineInfo,ShaderText::DESCRIPTOR_SET_GLYPH_BOUNDS_BUFFER);
+	AddDescriptorSetGroup(pipelineInfo,DESCRIPTOR_SET_GLYPH_BLOCK_ORIGIN_BUFFER);
 	AttachPushConstantRange(pipelineInfo,0u,sizeof(PushConstants),prosper::ShaderStageFlags::VertexBit | prosper::ShaderStageFlags::FragmentBit);
 }
 
 ///////////////////////
 
-decltype(ShaderTextRectColor::VERTEX_BINDING_COLOR) ShaderTextRectColor::VERTEX_BINDING_COLOR = {prosper::VertexInputRate::Instance};
-decltype(ShaderTextRectColor::VERTEX_ATTRIBUTE_COLOR) ShaderTextRectColor::VERTEX_ATTRIBUTE_COLOR = {VERTEX_BINDING_COLOR,prosper::Format::R32G32B32A32_SFloat};
-ShaderTextRectColor::ShaderTextRectColor(prosper::IPrContext &context,const std::string &identifier)
-	: ShaderTextRectColor{context,identifier,"wgui/vs_wgui_text_cheap_color","wgui/fs_wgui_text_cheap_color"}
+decltype(ShaderTextBatch::VERTEX_BINDING_INSTANCE) ShaderTextBatch::VERTEX_BINDING_INSTANCE = {prosper::VertexInputRate::Instance};
+decltype(ShaderTextBatch::VERTEX_ATTRIBUTE_GLYPH_INDEX) ShaderTextBatch::VERTEX_ATTRIBUTE_GLYPH_INDEX = {VERTEX_BINDING_INSTANCE,prosper::Format::R16_UInt};
+decltype(ShaderTextBatch::VERTEX_ATTRIBUTE_GLYPH_FLAGS) ShaderTextBatch::VERTEX_ATTRIBUTE_GLYPH_FLAGS = {VERTEX_BINDING_INSTANCE,prosper::Format::R16_UInt};
+decltype(ShaderTextBatch::VERTEX_ATTRIBUTE_GLYPH_POSITION) ShaderTextBatch::VERTEX_ATTRIBUTE_GLYPH_POSITION = {VERTEX_BINDING_INSTANCE,prosper::Format::R32G32_UInt};
+decltype(ShaderTextBatch::VERTEX_ATTRIBUTE_GLYPH_COLOR) ShaderTextBatch::VERTEX_ATTRIBUTE_GLYPH_COLOR = {VERTEX_BINDING_INSTANCE,prosper::Format::R8G8B8A8_UNorm};
+decltype(ShaderTextBatch::VERTEX_ATTRIBUTE_DRAW_INDEX) ShaderTextBatch::VERTEX_ATTRIBUTE_DRAW_INDEX = {VERTEX_BINDING_INSTANCE,prosper::Format::R32_UInt};
+
+decltype(ShaderTextBatch::DESCRIPTOR_SET_DRAW_DATA_BUFFER) ShaderTextBatch::DESCRIPTOR_SET_DRAW_DATA_BUFFER = {
+	{
+		prosper::DescriptorSetInfo::Binding {
+			prosper::DescriptorType::StorageBuffer,
+			prosper::ShaderStageFlags::VertexBit
+		}
+	}
+};
+ShaderTextBatch::ShaderTextBatch(prosper::IPrContext &context,const std::string &identifier)
+	: ShaderTextBatch{context,identifier,"wgui/vs_wgui_text_batch","wgui/fs_wgui_text_batch"}
 {}
-ShaderTextRectColor::ShaderTextRectColor(prosper::IPrContext &context,const std::string &identifier,const std::string &vsShader,const std::string &fsShader,const std::string &gsShader)
-	: ShaderTextRect{context,identifier,vsShader,fsShader,gsShader}
+ShaderTextBatch::ShaderTextBatch(prosper::IPrContext &context,const std::string &identifier,const std::string &vsShader,const std::string &fsShader,const std::string &gsShader)
+	: ShaderText{context,identifier,vsShader,fsShader,gsShader}
 {}
-bool ShaderTextRectColor::Draw(
-	prosper::IBuffer &glyphBoundsIndexBuffer,prosper::IBuffer &colorBuffer,
-	prosper::IDescriptorSet &descTextureSet,const PushConstants &pushConstants,
-	uint32_t instanceCount
+bool ShaderTextBatch::Draw(
+	prosper::IBuffer &instanceBuffer,prosper::DeviceSize instanceBufferOffset,
+	prosper::IDescriptorSet &descTextureSet,prosper::IDescriptorSet &descGlyphBoundsSet,prosper::IDescriptorSet &descDrawDataSet,
+	const PushConstants &pushConstants,uint32_t instanceCount
 )
 {
-	return RecordBindVertexBuffers({&colorBuffer},2u) && ShaderTextRect::Draw(glyphBoundsIndexBuffer,descTextureSet,pushConstants,instanceCount);
+	if(
+		RecordBindVertexBuffers({
+			prosper::util::get_square_vertex_uv_buffer(GetContext()).get(),&instanceBuffer
+		},0u,{0ull,instanceBufferOffset}) == false ||
+		RecordBindDescriptorSets({&descTextureSet,&descGlyphBoundsSet,&descDrawDataSet}) == false ||
+		RecordPushConstants(pushConstants) == false ||
+		RecordDraw(prosper::util::get_square_vertex_count(),instanceCount) == false
+	)
+		return false;
+	return true;
 }
-void ShaderTextRectColor::InitializeGfxPipeline(prosper::GraphicsPipelineCreateInfo &pipelineInfo,uint32_t pipelineIdx)
+void ShaderTextBatch::InitializeRenderPass(std::shared_ptr<prosper::IRenderPass> &outRenderPass,uint32_t pipelineIdx)
 {
-	ShaderTextRect::InitializeGfxPipeline(pipelineInfo,pipelineIdx);
-	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_COLOR);
+	CreateCachedRenderPass<ShaderTextBatch>({{{
+		prosper::Format::R8G8B8A8_UNorm,prosper::ImageLayout::ColorAttachmentOptimal,prosper::AttachmentLoadOp::DontCare,
+		prosper::AttachmentStoreOp::Store,prosper::SampleCountFlags::e1Bit,prosper::ImageLayout::ShaderReadOnlyOptimal
+	}}},outRenderPass,pipelineIdx);
+}
+void ShaderTextBatch::InitializeGfxPipeline(prosper::GraphicsPipelineCreateInfo &pipelineInfo,uint32_t pipelineIdx)
+{
+	Shader::InitializeGfxPipeline(pipelineInfo,pipelineIdx);
+
+	SetGenericAlphaColorBlendAttachmentProperties(pipelineInfo);
+	AddVertexAttribute(pipelineInfo,ShaderText::VERTEX_ATTRIBUTE_POSITION);
+	AddVertexAttribute(pipelineInfo,ShaderText::VERTEX_ATTRIBUTE_UV);
+	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_INDEX);
+	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_FLAGS);
+	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_POSITION);
+	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_GLYPH_COLOR);
+	AddVertexAttribute(pipelineInfo,VERTEX_ATTRIBUTE_DRAW_INDEX);
+	AddDescriptorSetGroup(pipelineInfo,ShaderText::DESCRIPTOR_SET_TEXTURE);
+	AddDescriptorSetGroup(pipelineInfo,ShaderText::DESCRIPTOR_SET_GLYPH_BOUNDS_BUFFER);
+	AddDescriptorSetGroup(pipelineInfo,DESCRIPTOR_SET_DRAW_DATA_BUFFER);
+	AttachPushConstantRange(pipelineInfo,0u,sizeof(PushConstants),prosper::ShaderStageFlags::VertexBit | prosper::ShaderStageFlags::FragmentBit);
 }
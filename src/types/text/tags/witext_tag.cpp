@@ -4,7 +4,6 @@
 
 #include "stdafx_wgui.h"
 #include "wgui/types/witext.h"
-#include "wgui/types/wirect.h"
 #include "wgui/types/witext_tags.hpp"
 #include "wgui/types/witext_iterator.hpp"
 #include <sharedutils/util_shared_handle.hpp>
@@ -37,62 +36,32 @@ util::text::TextOffset WITextDecorator::GetEndTextCharOffset() const
 	return pEndAnchorPoint->GetTextCharOffset();
 }
 
-void WITextDecorator::Clear()
+void WITextDecorator::Clear() {m_quads.clear();}
+bool WITextDecorator::IsValid() const {return GetStartAnchorPoint() != nullptr;}
+void WITextDecorator::SetDirty(bool dirty)
 {
-	for(auto &hOverlay : m_overlays)
-	{
-		if(hOverlay.IsValid())
-			hOverlay->Remove();
-	}
-	m_overlays.clear();
+	if(dirty == m_bDirty)
+		return;
+	m_bDirty = dirty;
+	if(dirty)
+		m_text.MarkDecoratorDirty(*this);
 }
-bool WITextDecorator::IsValid() const {return GetStartAnchorPoint() != nullptr;}
-void WITextDecorator::SetDirty(bool dirty) {m_bDirty = dirty;}
 bool WITextDecorator::IsDirty() const {return m_bDirty;}
 bool WITextDecorator::IsTag() const {return false;}
-void WITextDecorator::InitializeOverlay(WIBase &overlay) {}
-
-void WITextDecorator::CreateOverlayElement(util::text::LineIndex lineIndex,util::text::TextOffset startOffset,util::text::TextOffset endOffset,std::vector<WIHandle> &cachedOverlays)
-{
-	auto startBounds = m_text.GetCharacterPixelBounds(lineIndex,startOffset);
-	auto endBounds = m_text.GetCharacterPixelBounds(lineIndex,endOffset);
-
-	WIHandle hOverlay = {};
-	while(hOverlay.IsValid() == false && cachedOverlays.empty() == false)
-	{
-		hOverlay = cachedOverlays.front();
-		cachedOverlays.erase(cachedOverlays.begin());
-	}
-	if(hOverlay.IsValid() == false)
-	{
-		auto *p = WGUI::GetInstance().Create<WIBase>(&m_text);
-		p->SetZPos(3);
-		// auto *pBg = WGUI::GetInstance().Create<WIRect>(p);
-		// pBg->SetColor(Color{255,0,0,128});
-		// pBg->SetAutoAlignToParent(true);
-		InitializeOverlay(*p);
-		hOverlay = p->GetHandle();
-	}
-	auto *p = hOverlay.get();
-	auto pos = startBounds.first;
-	auto size = endBounds.second -startBounds.first;
-	CalcBounds(pos,size);
-	p->SetSize(size);
-	p->SetPos(pos);
-	m_overlays.push_back(hOverlay);
-}
-
-void WITextDecorator::CalcBounds(Vector2i &inOutPos,Vector2i &inOutSize) {}
-
-void WITextDecorator::CreateOverlayElements()
+const std::vector<WITextDecorator::Quad> &WITextDecorator::GetQuads() const {return m_quads;}
+bool WITextDecorator::IsInteractive() const {return false;}
+util::EventReply WITextDecorator::OnClicked() {return util::EventReply::Unhandled;}
+std::string WITextDecorator::GetTooltip() const {return "";}
+GLFW::Cursor::Shape WITextDecorator::GetCursor() const {return GLFW::Cursor::Shape::Default;}
+void WITextDecorator::AddQuads(const Vector2i &pos,const Vector2i &size,std::vector<Quad> &outQuads) {}
+
+void WITextDecorator::UpdateQuads()
 {
+	m_quads.clear();
 	util::text::LineIndex startLineIdx,endLineIdx;
 	util::text::TextOffset absStartCharOffset,absEndCharOffset;
 	GetTagRange(startLineIdx,endLineIdx,absStartCharOffset,absEndCharOffset);
 
-	auto overlays = m_overlays;
-	m_overlays.clear();
-
 	TextLineIterator lineIt {m_text,startLineIdx};
 	for(auto &lineInfo : lineIt)
 	{
@@ -106,14 +75,19 @@ void WITextDecorator::CreateOverlayElements()
 			break;
 		if(numChars == -2)
 			continue;
-		CreateOverlayElement(lineInfo.lineIndex,startOffsetRelToLine,endOffsetRelToLine,overlays);
-	}
-	for(auto &hOverlay : overlays)
-	{
-		if(hOverlay.IsValid() == false)
-			continue;
-		hOverlay->Remove();
+		auto startBounds = m_text.GetCharacterPixelBounds(lineInfo.lineIndex,startOffsetRelToLine);
+		auto endBounds = m_text.GetCharacterPixelBounds(lineInfo.lineIndex,endOffsetRelToLine);
+		AddQuads(startBounds.first,endBounds.second -startBounds.first,m_quads);
 	}
+	// Quads are positioned relative to the sub-line origin of the text, see WIText::m_subLineOrigin
+	auto yOrigin = static_cast<int32_t>(m_text.m_subLineOrigin *m_text.GetLineHeight());
+	for(auto &quad : m_quads)
+		quad.pos.y += yOrigin;
+}
+void WITextDecorator::OnRangeChanged()
+{
+	m_text.OnDecoratorRangeChanged(*this);
+	SetDirty();
 }
 int32_t WITextDecorator::GetTagRange(
 	const util::text::FormattedTextLine &line,util::text::CharOffset minOffsetInLine,util::text::CharOffset maxOffsetInLine,
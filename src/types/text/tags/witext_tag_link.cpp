@@ -4,7 +4,6 @@
 
 #include "stdafx_wgui.h"
 #include "wgui/types/witext_tags.hpp"
-#include "wgui/wibase.h"
 #include <sharedutils/functioncallback.h>
 #include <sharedutils/util_event_reply.hpp>
 #include <util_formatted_text_tag.hpp>
@@ -14,19 +13,17 @@ void WITextTagLink::set_link_handler(const std::function<void(const std::string&
 {
 	s_linkHandler = linkHandler;
 }
-void WITextTagLink::InitializeOverlay(WIBase &overlay)
+bool WITextTagLink::IsInteractive() const {return true;}
+util::EventReply WITextTagLink::OnClicked()
 {
-	WITextTagUnderline::InitializeOverlay(overlay);
-	overlay.AddCallback("OnMouseReleased",FunctionCallback<util::EventReply>::CreateWithOptionalReturn([this](util::EventReply *reply) mutable -> CallbackReturnType {
-		if(m_cbFunction.IsValid() == false)
-			return CallbackReturnType::NoReturnValue;
-		return m_cbFunction.Call<util::EventReply,std::reference_wrapper<const std::vector<std::string>>>(reply,m_strArgs);
-	}));
-	overlay.SetZPos(20);
-	overlay.SetMouseInputEnabled(true);
-	overlay.SetMouseMovementCheckEnabled(true);
-	overlay.SetCursor(GLFW::Cursor::Shape::Hand);
+	if(m_cbFunction.IsValid() == false)
+		return util::EventReply::Unhandled;
+	auto reply = util::EventReply::Unhandled;
+	if(m_cbFunction.Call<util::EventReply,std::reference_wrapper<const std::vector<std::string>>>(&reply,m_strArgs) != CallbackReturnType::HasReturnValue)
+		return util::EventReply::Unhandled;
+	return reply;
 }
+GLFW::Cursor::Shape WITextTagLink::GetCursor() const {return GLFW::Cursor::Shape::Hand;}
 void WITextTagLink::Initialize()
 {
 	auto type = m_args.front().type;
@@ -64,8 +61,3 @@ void WITextTagLink::Initialize()
 		}
 	}
 }
-void WITextTagLink::Apply()
-{
-	CreateOverlayElements();
-	WITextTagUnderline::Apply();
-}
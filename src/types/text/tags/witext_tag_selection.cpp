@@ -5,7 +5,6 @@
 #include "stdafx_wgui.h"
 #include "wgui/types/witext_tags.hpp"
 #include "wgui/types/witext.h"
-#include "wgui/types/wirect.h"
 #include <util_formatted_text_anchor_point.hpp>
 #include <util_formatted_text.hpp>
 #include <util_formatted_text_line.hpp>
@@ -31,31 +30,56 @@ std::optional<std::pair<util::text::LineIndex,util::text::CharOffset>> WITextTag
 }
 util::text::AnchorPoint *WITextTagSelection::GetStartAnchorPoint() {return m_startAnchorPoint.Get();}
 util::text::AnchorPoint *WITextTagSelection::GetEndAnchorPoint() {return m_endAnchorPoint.Get();}
-void WITextTagSelection::CalcBounds(Vector2i &inOutPos,Vector2i &inOutSize) {inOutPos.y += 2;}
+void WITextTagSelection::AddQuads(const Vector2i &pos,const Vector2i &size,std::vector<Quad> &outQuads)
+{
+	outQuads.push_back({});
+	auto &quad = outQuads.back();
+	quad.pos = {pos.x,pos.y +2};
+	quad.size = size;
+	quad.color = {0.75f,0.75f,0.75f,1.f};
+	quad.layer = Quad::Layer::Background;
+}
 void WITextTagSelection::SetStartOffset(util::text::TextOffset offset)
 {
 	auto &formattedText = m_text.GetFormattedTextObject();
 	auto absOffset = formattedText.GetUnformattedTextOffset(offset);
-	if(m_startAnchorPoint.IsValid() && absOffset.has_value())
-		m_startAnchorPoint->ShiftToOffset(*absOffset);
+	if(m_startAnchorPoint.IsValid() == false || absOffset.has_value() == false)
+		return;
+	m_startAnchorPoint->ShiftToOffset(*absOffset);
+	OnRangeChanged();
 }
 void WITextTagSelection::SetEndOffset(util::text::TextOffset offset)
 {
 	auto &formattedText = m_text.GetFormattedTextObject();
 	auto absOffset = formattedText.GetUnformattedTextOffset(offset);
-	if(m_endAnchorPoint.IsValid() && absOffset.has_value())
-		m_endAnchorPoint->ShiftToOffset(*absOffset);
+	if(m_endAnchorPoint.IsValid() == false || absOffset.has_value() == false)
+		return;
+	m_endAnchorPoint->ShiftToOffset(*absOffset);
+	OnRangeChanged();
 }
-void WITextTagSelection::InitializeOverlay(WIBase &overlay)
+void WITextTagSelection::SetRange(util::text::TextOffset startOffset,util::text::TextOffset endOffset)
 {
-	overlay.SetZPos(5);
-	auto *pRect = WGUI::GetInstance().Create<WIRect>(&overlay);
-	pRect->SetAutoAlignToParent(true);
-	pRect->SetColor(0.75f,0.75f,0.75f);
+	auto &formattedText = m_text.GetFormattedTextObject();
+	auto absStartOffset = formattedText.GetUnformattedTextOffset(startOffset);
+	auto absEndOffset = formattedText.GetUnformattedTextOffset(endOffset);
+	if(IsValid() == false || absStartOffset.has_value() == false || absEndOffset.has_value() == false)
+		return;
+	// The anchor points are moved in an order that keeps the start in front of the end
+	if(*absStartOffset > m_endAnchorPoint->GetTextCharOffset())
+	{
+		m_endAnchorPoint->ShiftToOffset(*absEndOffset);
+		m_startAnchorPoint->ShiftToOffset(*absStartOffset);
+	}
+	else
+	{
+		m_startAnchorPoint->ShiftToOffset(*absStartOffset);
+		m_endAnchorPoint->ShiftToOffset(*absEndOffset);
+	}
+	OnRangeChanged();
 }
 bool WITextTagSelection::IsValid() const {return m_startAnchorPoint.IsValid() && m_endAnchorPoint.IsValid();}
 void WITextTagSelection::Apply()
 {
 	WITextDecorator::Apply();
-	CreateOverlayElements();
+	UpdateQuads();
 }
@@ -4,17 +4,12 @@
 
 #include "stdafx_wgui.h"
 #include "wgui/types/witext_tags.hpp"
-#include "wgui/wibase.h"
 #include <util_formatted_text_tag.hpp>
 
-void WITextTagTooltip::InitializeOverlay(WIBase &overlay)
+bool WITextTagTooltip::IsInteractive() const {return true;}
+std::string WITextTagTooltip::GetTooltip() const
 {
-	overlay.SetTooltip(*static_cast<std::string*>(m_args.front().value.get()));
-}
-void WITextTagTooltip::Apply()
-{
-	WITextDecorator::Apply();
 	if(m_args.empty() || m_args.front().type != WITextTagArgument::Type::String)
-		return;
-	CreateOverlayElements();
+		return "";
+	return *static_cast<std::string*>(m_args.front().value.get());
 }
@@ -5,27 +5,22 @@
 #include "stdafx_wgui.h"
 #include "wgui/types/witext_tags.hpp"
 #include "wgui/types/witext.h"
-#include "wgui/types/wirect.h"
 #include <util_formatted_text_tag.hpp>
 
-void WITextTagUnderline::InitializeOverlay(WIBase &overlay)
+void WITextTagUnderline::AddQuads(const Vector2i &pos,const Vector2i &size,std::vector<Quad> &outQuads)
 {
-	auto *pUnderline = WGUI::GetInstance().Create<WIRect>(&overlay);
-	auto hOverlay = overlay.GetHandle();
-	overlay.AddCallback("SetSize",FunctionCallback<void>::Create([this,pUnderline,hOverlay]() {
-		if(hOverlay.IsValid() == false)
-			return;
-		pUnderline->SetPos(Vector2i{0,hOverlay.get()->GetHeight() -1});
-		pUnderline->SetSize(Vector2i{hOverlay.get()->GetWidth(),1});
-		pUnderline->SetColor(m_underlineColor);
-	}));
+	outQuads.push_back({});
+	auto &quad = outQuads.back();
+	quad.pos = {pos.x,pos.y +size.y +1};
+	quad.size = {size.x,1};
+	quad.color = m_underlineColor.ToVector4();
+	quad.layer = Quad::Layer::Foreground;
 }
-void WITextTagUnderline::CalcBounds(Vector2i &inOutPos,Vector2i &inOutSize) {inOutSize.y += 2;}
 void WITextTagUnderline::Apply()
 {
 	WITextDecorator::Apply();
 	auto startOffset = m_tag.GetOpeningTagComponent()->GetStartAnchorPoint()->GetTextCharOffset();
 	m_underlineColor = m_text.GetCharColor(startOffset); // Use color of first character as color for underline
 
-	CreateOverlayElements();
+	UpdateQuads();
 }
@@ -11,11 +11,16 @@
 #include <prosper_context.hpp>
 #include <sharedutils/property/util_property_color.hpp>
 #include <sharedutils/util.h>
+#include <algorithm>
 
 LINK_WGUI_TO_CLASS(WIText,WIText);
 
 #pragma optimize("",off)
 decltype(WIText::s_textBuffer) WIText::s_textBuffer = nullptr;
+decltype(WIText::s_glyphBlockOriginBuffer) WIText::s_glyphBlockOriginBuffer = nullptr;
+decltype(WIText::s_glyphBlockOriginDsg) WIText::s_glyphBlockOriginDsg = nullptr;
+decltype(WIText::s_cacheAtlas) WIText::s_cacheAtlas = nullptr;
+decltype(WIText::s_blurCompositor) WIText::s_blurCompositor = nullptr;
 WIText::WIText()
 	: WIBase(),m_font(nullptr),m_breakHeight(0),m_wTexture(0),m_hTexture(0),
 	m_autoBreak(AutoBreak::NONE),m_renderTarget(nullptr)
@@ -24,38 +29,88 @@ WIText::WIText()
 
 	m_text = util::text::FormattedText::Create();
 	util::text::FormattedText::Callbacks callbacks {};
-	const auto fShiftBufferLines = [this](util::text::LineIndex lineIndex,int32_t shiftOffset) {
-		for(auto i=lineIndex;i<m_lineInfos.size();++i)
-		{
-			auto &lineInfo = m_lineInfos.at(i);
-			for(auto &bufInfo : lineInfo.buffers)
-				bufInfo.absLineIndex += shiftOffset;
-		}
-	};
-	callbacks.onLineAdded = [this,fShiftBufferLines](util::text::FormattedTextLine &line) {
+	callbacks.onLineAdded = [this](util::text::FormattedTextLine &line) {
 		auto lineIdx = line.GetIndex();
-		auto &lineInfo = *m_lineInfos.insert(m_lineInfos.begin() +lineIdx,LineInfo{});
+		auto &lineInfo = *m_lineInfos.insert(m_lineInfos.begin() +lineIdx,PopRecycledLineInfo());
 		lineInfo.wpLine = line.shared_from_this();
+		if(umath::is_flag_set(m_flags,Flags::BulkTextUpdate))
+			return;
+		QueueLineMeasurement(lineInfo);
+		m_subLineOffsets.Insert(lineIdx,1);
+		m_lineTextOffsets.Insert(lineIdx,line.GetAbsFormattedLength());
+		if(lineIdx > 0)
+			UpdateLineTextOffset(lineIdx -1); // The previous line may have received a new-line character
+		m_firstShiftedLine = umath::min(m_firstShiftedLine,lineIdx);
+		MarkLineDirty(lineIdx);
 		ScheduleRenderUpdate();
 		PerformTextPostProcessing();
-
-		fShiftBufferLines(lineIdx +1,1);
 	};
-	callbacks.onLineRemoved = [this,fShiftBufferLines](util::text::FormattedTextLine &line) {
+	callbacks.onLineRemoved = [this](util::text::FormattedTextLine &line) {
 		auto lineIdx = line.GetIndex();
+		auto &lineInfo = m_lineInfos.at(lineIdx);
+		if(lineInfo.charPxOffsets.empty() == false && lineInfo.charPxOffsets.back() >= m_maxLineWidth)
+			InvalidateMaxLineWidth(); // The widest line has been removed
+		if(umath::is_flag_set(m_flags,Flags::BulkTextUpdate))
+		{
+			FreeGlyphRange(lineInfo.glyphOffset,lineInfo.glyphCapacity);
+			m_lineInfos.erase(m_lineInfos.begin() +lineIdx);
+			return;
+		}
+		if(IsLogModeEnabled())
+			RecycleLineInfo(lineInfo);
+		else
+			FreeGlyphRange(lineInfo.glyphOffset,lineInfo.glyphCapacity);
+		if(lineIdx == 0)
+		{
+			// The remaining lines keep their glyph positions, the text is moved up instead (see m_subLineOrigin)
+			// Decoration quads are relative to the origin as well, so they don't have to be updated either.
+			m_subLineOrigin += m_subLineOffsets.Get(0);
+			if(m_firstShiftedLine > 0 && m_firstShiftedLine != std::numeric_limits<util::text::LineIndex>::max())
+				--m_firstShiftedLine;
+		}
+		else
+			m_firstShiftedLine = umath::min(m_firstShiftedLine,lineIdx);
 		m_lineInfos.erase(m_lineInfos.begin() +lineIdx);
+		m_subLineOffsets.Erase(lineIdx);
+		m_lineTextOffsets.Erase(lineIdx);
+		if(lineIdx > 0)
+			UpdateLineTextOffset(lineIdx -1);
 		SetFlag(Flags::ApplySubTextTags);
+		ScheduleRenderUpdate();
 		PerformTextPostProcessing();
-
-		fShiftBufferLines(lineIdx,-1);
 	};
 	callbacks.onLineChanged = [this](util::text::FormattedTextLine &line) {
-		m_lineInfos.at(line.GetIndex()).bufferUpdateRequired = true;
+		auto lineIdx = line.GetIndex();
+		auto &lineInfo = m_lineInfos.at(lineIdx);
+		lineInfo.bufferUpdateRequired = true;
+		if(umath::is_flag_set(m_flags,Flags::BulkTextUpdate))
+		{
+			lineInfo.metricsUpdateRequired = true;
+			return;
+		}
+		MarkLineMetricsDirty(lineInfo);
+		m_lineTextOffsets.Set(lineIdx,line.GetAbsFormattedLength());
+		MarkLineDirty(lineIdx);
 		ScheduleRenderUpdate();
 		PerformTextPostProcessing();
 	};
 	callbacks.onTextCleared = [this]() {
 		m_lineInfos.clear();
+		m_subLineOffsets.Clear();
+		m_lineTextOffsets.Clear();
+		m_dirtyLines.clear();
+		m_unmeasuredLines.clear();
+		m_maxLineWidth = 0;
+		m_maxLineWidthValid = true;
+		// All glyph instances are unused now, but the buffers can be re-used for the new text
+		m_numGlyphInstances = 0u;
+		m_numFreeGlyphInstances = 0u;
+		m_freeGlyphRanges.clear();
+		m_dirtyGlyphRanges.clear();
+		m_firstShiftedLine = std::numeric_limits<util::text::LineIndex>::max();
+		m_subLineOrigin = 0;
+		m_recycledLineInfo = {};
+		umath::set_flag(m_flags,Flags::HasGlyphColors,false);
 		PerformTextPostProcessing();
 	};
 	callbacks.onTagAdded = [this](util::text::TextTag &tag) {
@@ -91,7 +146,10 @@ WIText::WIText()
 			return tagOther->IsTag() && &static_cast<WITextTag&>(*tagOther).GetTag() == &tag;
 		});
 		if(it != m_tagInfos.end())
+		{
+			OnDecoratorRemoved(**it);
 			m_tagInfos.erase(it);
+		}
 
 		auto *pOpeningTagComponent = tag.GetOpeningTagComponent();
 		if(pOpeningTagComponent == nullptr)
@@ -115,6 +173,13 @@ WIText::WIText()
 	};
 	callbacks.onTagsCleared = [this]() {
 		m_tagInfos.clear();
+		m_dirtyDecorators.clear();
+		m_decoratorLineSpans.clear();
+		m_unclosedDecorators.clear();
+		m_maxDecoratorLineSpan = 0;
+		m_numInteractiveDecorators = 0u;
+		m_flags |= Flags::DecorationsDirty;
+		SetFlag(Flags::ApplySubTextTags);
 	};
 	m_text->SetCallbacks(callbacks);
 	SetTagsEnabled(false);
@@ -131,12 +196,11 @@ WIText::WIText()
 WIText::~WIText()
 {
 	auto &context = WGUI::GetInstance().GetContext();
-	context.KeepResourceAliveUntilPresentationComplete(m_renderTarget);
-	context.KeepResourceAliveUntilPresentationComplete(m_shadowRenderTarget);
-	context.KeepResourceAliveUntilPresentationComplete(m_shadowBlurSet);
+	ReleaseCacheRegion();
+	context.KeepResourceAliveUntilPresentationComplete(m_glyphBuffer);
+	context.KeepResourceAliveUntilPresentationComplete(m_glyphBlockOriginBuffer);
 
 	DestroyShadow();
-	DestroyBlur();
 }
 
 void WIText::SetAutoSizeToText(bool bAutoSize) {m_bAutoSizeToText = bAutoSize;}
@@ -147,71 +211,38 @@ std::string WIText::GetDebugInfo() const {return "Text: " +GetText();}
 
 std::pair<Vector2i,Vector2i> WIText::GetCharacterPixelBounds(util::text::LineIndex lineIdx,util::text::CharOffset charOffset) const
 {
-	if(lineIdx >= m_lineInfos.size())
+	auto *lineInfo = const_cast<WIText*>(this)->GetUpdatedLineInfo(lineIdx);
+	if(lineInfo == nullptr)
 		return {{0,0},{0,0}};
-	auto &lineInfo = m_lineInfos.at(lineIdx);
-	auto &line = *m_text->GetLine(lineIdx);
-	auto &strLine = line.GetFormattedLine().GetText();
-	if(strLine.empty())
+	auto &pxOffsets = lineInfo->charPxOffsets;
+	if(pxOffsets.size() < 2)
 		return {{0,0},{0,0}};
-	if(charOffset >= strLine.size())
-		charOffset = strLine.size() -1;
-	auto strViewLine = std::string_view{strLine};
+	if(charOffset >= pxOffsets.size() -1)
+		charOffset = pxOffsets.size() -2;
 
-	std::string strHidden;
-	if(IsTextHidden())
-	{
-		strHidden = std::string(strViewLine.length(),'*');
-		strViewLine = strHidden;
-	}
-
-	auto subLineIndex = lineInfo.subLineIndexOffset;
-	util::text::CharOffset offset = 0;
-	util::text::CharOffset lineStartOffset = 0;
-	for(auto numChars : lineInfo.subLines)
-	{
-		auto endOffset = offset +numChars;
-		if(charOffset >= endOffset)
-		{
-			++subLineIndex;
-			lineStartOffset = endOffset;
-		}
-		else
-			break;
-		offset = endOffset;
-	}
+	auto relSubLineIdx = GetSubLineIndex(lineIdx,charOffset);
+	auto subLineStartOffset = lineInfo->subLineOffsets.empty() ? 0 : lineInfo->subLineOffsets.at(relSubLineIdx);
+	auto subLineStartPx = pxOffsets.at(subLineStartOffset);
 
 	Vector2i startOffset {};
-	startOffset.y = subLineIndex *GetLineHeight();
-	FontManager::GetTextSize(strViewLine.substr(lineStartOffset,charOffset -lineStartOffset),0u,GetFont(),&startOffset.x);
+	startOffset.x = pxOffsets.at(charOffset) -subLineStartPx;
+	startOffset.y = (GetSubLineIndexOffset(lineIdx) +relSubLineIdx) *GetLineHeight();
 
-	auto endOffset = startOffset;
-	endOffset.y += GetLineHeight();
-	FontManager::GetTextSize(strViewLine.at(charOffset),charOffset,GetFont(),&endOffset.x);
-	endOffset.x += startOffset.x;
+	Vector2i endOffset {};
+	endOffset.x = pxOffsets.at(charOffset +1) -subLineStartPx;
+	endOffset.y = startOffset.y +GetLineHeight();
 	return {startOffset,endOffset};
 }
 
  void WIText::Initialize()
 {
 	WIBase::Initialize();
-	m_baseEl = CreateChild<WITextBase>();
-	auto *el = static_cast<WITextBase*>(m_baseEl.get());
-	if(el != NULL)
-	{
-		el->SetZPos(10);
-		el->SetTextElement(*this);
-		el->SetAutoAlignToParent(true);
-		el->GetColorProperty()->Link(*GetColorProperty());
-	}
 
 	SetText("");
 	SetFont(FontManager::GetDefaultFont().get());
 	InitializeTextBuffer(WGUI::GetInstance().GetContext());
 }
 
- WITextBase *WIText::GetBaseElement() {return static_cast<WITextBase*>(m_baseEl.get());}
-
 void WIText::SetSize(int x,int y)
 {
 	auto oldWidth = GetWidth();
@@ -221,16 +252,77 @@ void WIText::SetSize(int x,int y)
 }
 
 const FontInfo *WIText::GetFont() const {return m_font.get();}
-const std::vector<WIText::LineInfo> &WIText::GetLines() const {return const_cast<WIText*>(this)->GetLines();}
-std::vector<WIText::LineInfo> &WIText::GetLines() {return m_lineInfos;}
+const std::deque<WIText::LineInfo> &WIText::GetLines() const {return const_cast<WIText*>(this)->GetLines();}
+std::deque<WIText::LineInfo> &WIText::GetLines() {return m_lineInfos;}
 util::text::FormattedTextLine *WIText::GetLine(util::text::LineIndex lineIdx) {return m_text->GetLine(lineIdx);}
 uint32_t WIText::GetLineCount() const {return m_text->GetLineCount();}
-uint32_t WIText::GetTotalLineCount() const
+uint32_t WIText::GetTotalLineCount() const {return m_subLineOffsets.GetTotal();}
+util::text::LineIndex WIText::GetSubLineIndexOffset(util::text::LineIndex lineIdx) const {return m_subLineOffsets.GetOffset(lineIdx);}
+util::text::LineIndex WIText::GetLineIndexFromSubLineIndex(util::text::LineIndex subLineIdx) const {return m_subLineOffsets.FindIndex(subLineIdx);}
+util::text::TextOffset WIText::GetLineStartOffset(util::text::LineIndex lineIdx) const {return m_lineTextOffsets.GetOffset(lineIdx);}
+util::text::LineIndex WIText::GetLineIndexFromTextOffset(util::text::TextOffset offset) const
+{
+	auto numLines = m_lineTextOffsets.GetSize();
+	if(numLines == 0)
+		return util::text::INVALID_LINE_INDEX;
+	return umath::min<size_t>(m_lineTextOffsets.FindIndex(offset),numLines -1);
+}
+util::text::LineIndex WIText::GetSubLineIndex(util::text::LineIndex lineIdx,util::text::CharOffset charOffset) const
+{
+	if(lineIdx >= m_lineInfos.size())
+		return 0;
+	auto &subLineOffsets = m_lineInfos.at(lineIdx).subLineOffsets;
+	if(subLineOffsets.empty())
+		return 0;
+	auto it = std::upper_bound(subLineOffsets.begin(),subLineOffsets.end(),charOffset);
+	return (it != subLineOffsets.begin()) ? ((it -subLineOffsets.begin()) -1) : 0;
+}
+int32_t WIText::GetCharPixelOffset(util::text::LineIndex lineIdx,util::text::CharOffset charOffset)
 {
-	if(m_lineInfos.empty())
+	auto *lineInfo = GetUpdatedLineInfo(lineIdx);
+	if(lineInfo == nullptr)
 		return 0;
-	auto &lastLine = m_lineInfos.back();
-	return lastLine.subLineIndexOffset +(lastLine.subLines.empty() ? 1 : lastLine.subLines.size());
+	auto &pxOffsets = lineInfo->charPxOffsets;
+	charOffset = umath::min<util::text::CharOffset>(charOffset,pxOffsets.size() -1);
+	auto relSubLineIdx = GetSubLineIndex(lineIdx,charOffset);
+	auto subLineStartOffset = lineInfo->subLineOffsets.empty() ? 0 : lineInfo->subLineOffsets.at(relSubLineIdx);
+	return pxOffsets.at(charOffset) -pxOffsets.at(subLineStartOffset);
+}
+util::text::CharOffset WIText::FindCharOffset(util::text::LineIndex lineIdx,util::text::LineIndex relSubLineIdx,int32_t x)
+{
+	auto *lineInfo = GetUpdatedLineInfo(lineIdx);
+	if(lineInfo == nullptr)
+		return 0;
+	auto &pxOffsets = lineInfo->charPxOffsets;
+	auto &subLineOffsets = lineInfo->subLineOffsets;
+	util::text::CharOffset lineLength = pxOffsets.size() -1;
+	util::text::CharOffset subLineStart = 0;
+	util::text::CharOffset subLineEnd = lineLength;
+	if(subLineOffsets.empty() == false)
+	{
+		relSubLineIdx = umath::min<util::text::LineIndex>(relSubLineIdx,subLineOffsets.size() -1);
+		subLineStart = subLineOffsets.at(relSubLineIdx);
+		if(relSubLineIdx +1 < subLineOffsets.size())
+		{
+			// The end offset of a sub-line is the start of the next sub-line, so the caret can only be placed in front of the last character
+			subLineEnd = subLineOffsets.at(relSubLineIdx +1);
+			if(subLineEnd > subLineStart)
+				--subLineEnd;
+		}
+	}
+	// First character whose horizontal center is behind x
+	auto targetPx = 2 *(pxOffsets.at(subLineStart) +x);
+	auto lo = subLineStart;
+	auto hi = subLineEnd;
+	while(lo < hi)
+	{
+		auto mid = lo +(hi -lo) /2;
+		if(pxOffsets.at(mid) +pxOffsets.at(mid +1) <= targetPx)
+			lo = mid +1;
+		else
+			hi = mid;
+	}
+	return lo;
 }
 int WIText::GetLineHeight() const {return m_font->GetSize() +m_breakHeight;}
 int WIText::GetBreakHeight() {return m_breakHeight;}
@@ -247,20 +339,53 @@ void WIText::SetFont(const FontInfo *font)
 	if(m_font.get() == font)
 		return;
 	m_font = (font != nullptr) ? font->shared_from_this() : nullptr;
+	InvalidateLineMetrics();
 	SetDirty();
 	CallCallbacks<void,const FontInfo*>("OnFontChanged",font);
 }
 
 void WIText::SetCacheEnabled(bool bEnabled)
 {
+	auto wasEnabled = IsCacheEnabled();
 	SetFlag(Flags::Cache,bEnabled);
+	if(bEnabled == false && wasEnabled)
+	{
+		// Dirty lines aren't tracked in cached mode (see UpdateRenderTexture), so all glyph buffers have to be updated
+		MarkAllLinesDirty();
+		ScheduleRenderUpdate(true);
+	}
 	if(bEnabled == true || m_renderTarget == nullptr)
 		return;
-	WGUI::GetInstance().GetContext().KeepResourceAliveUntilPresentationComplete(m_renderTarget);
-	m_renderTarget = nullptr;
+	ReleaseCacheRegion();
+	DestroyShadow();
+	// The glyphs are rendered by the text element itself again, the helper elements aren't needed anymore
+	if(m_cacheRect.IsValid())
+		m_cacheRect->Remove();
+	if(m_baseTextShadow.IsValid())
+		m_baseTextShadow->Remove();
 }
 bool WIText::IsCacheEnabled() const {return umath::is_flag_set(m_flags,Flags::Cache);}
 
+void WIText::SetVirtualized(bool virtualized)
+{
+	if(virtualized == IsVirtualized())
+		return;
+	SetFlag(Flags::Virtualized,virtualized);
+	m_materializedSubLineRange = {0,0};
+	m_materializedLines.clear();
+	if(virtualized)
+	{
+		// Buffers will be re-created for the visible lines during the next think
+		for(auto &lineInfo : m_lineInfos)
+			ReleaseTextBuffers(lineInfo);
+		EnableThinking();
+		return;
+	}
+	MarkAllLinesDirty();
+	ScheduleRenderUpdate();
+}
+bool WIText::IsVirtualized() const {return umath::is_flag_set(m_flags,Flags::Virtualized);}
+
 int WIText::GetTextHeight()
 {
 	if(m_font == nullptr)
@@ -281,14 +406,7 @@ void WIText::GetTextSize(int *w,int *h,const std::string_view *inText)
 	int wText = 0;
 	if(inText == nullptr)
 	{
-		for(auto &line : m_text->GetLines())
-		{
-			auto &formattedLine = line->GetFormattedLine();
-			int w;
-			FontManager::GetTextSize(formattedLine.GetText(),0u,m_font.get(),&w);
-			if(w > wText)
-				wText = w;
-		}
+		wText = GetMaxLineWidth();
 		auto lineCount = GetTotalLineCount();
 		int hText = GetLineHeight();//m_font->GetMaxGlyphSize();//m_font->GetSize();
 		*w = wText;
@@ -309,9 +427,18 @@ void WIText::SetFlag(Flags flag,bool enabled)
 void WIText::Think()
 {
 	WIBase::Think();
+	if(IsVirtualized())
+		UpdateVisibleSubLineRange();
 	UpdateRenderTexture();
-	if(umath::is_flag_set(m_flags,Flags::ApplySubTextTags | Flags::RenderTextScheduled | Flags::FullUpdateScheduled) == false)
-		DisableThinking();
+	if(umath::is_flag_set(m_flags,Flags::ApplySubTextTags | Flags::RenderTextScheduled | Flags::FullUpdateScheduled))
+		return;
+	// The visible range of virtualized texts has to be checked every frame, since the text may be scrolled by its parent
+	if(IsVirtualized())
+		return;
+	// Links and tooltips are hit-tested while the cursor is moved over the text
+	if(umath::is_flag_set(m_flags,Flags::HasInteractiveDecorators) && MouseInBounds())
+		return;
+	DisableThinking();
 }
 
 void WIText::SetDirty() {SetFlag(Flags::TextDirty);}
@@ -349,24 +476,112 @@ void WIText::SetAutoBreakMode(AutoBreak b)
 	if(b == m_autoBreak)
 		return;
 	m_autoBreak = b;
+	m_lineBreakWidth = -1;
 	SetAutoSizeToText(b != AutoBreak::NONE);
 	SizeToContents();
 }
 
-void WIText::AppendText(const std::string_view &text) {m_text->AppendText(text);}
+void WIText::BeginTextEdit() {++m_textEditDepth;}
+void WIText::EndTextEdit()
+{
+	if(m_textEditDepth == 0 || --m_textEditDepth > 0 || umath::is_flag_set(m_flags,Flags::PostProcessingPending) == false)
+		return;
+	umath::set_flag(m_flags,Flags::PostProcessingPending,false);
+	PerformTextPostProcessing();
+}
+void WIText::AppendText(const std::string_view &text)
+{
+	BeginTextEdit();
+	m_text->AppendText(text);
+	ApplyLogLineCapacity();
+	EndTextEdit();
+}
 bool WIText::InsertText(const std::string_view &text,util::text::LineIndex lineIdx,util::text::CharOffset charOffset)
 {
-	return m_text->InsertText(text,lineIdx,charOffset);
+	BeginTextEdit();
+	auto result = m_text->InsertText(text,lineIdx,charOffset);
+	EndTextEdit();
+	return result;
+}
+void WIText::AppendLine(const std::string_view &line)
+{
+	BeginTextEdit();
+	m_text->AppendLine(line);
+	ApplyLogLineCapacity();
+	EndTextEdit();
 }
-void WIText::AppendLine(const std::string_view &line) {m_text->AppendLine(line);}
 void WIText::PopFrontLine() {m_text->PopFrontLine();}
 void WIText::PopBackLine() {m_text->PopBackLine();}
+void WIText::SetLogMode(uint32_t lineCapacity)
+{
+	m_logLineCapacity = lineCapacity;
+	if(IsLogModeEnabled() == false)
+	{
+		if(m_recycledLineInfo.has_value())
+			FreeGlyphRange(m_recycledLineInfo->glyphOffset,m_recycledLineInfo->glyphCapacity);
+		m_recycledLineInfo = {};
+		return;
+	}
+	BeginTextEdit();
+	ApplyLogLineCapacity();
+	EndTextEdit();
+}
+bool WIText::IsLogModeEnabled() const {return m_logLineCapacity > 0;}
+uint32_t WIText::GetLogLineCapacity() const {return m_logLineCapacity;}
+void WIText::ApplyLogLineCapacity()
+{
+	if(IsLogModeEnabled() == false)
+		return;
+	while(m_text->GetLineCount() > m_logLineCapacity)
+		m_text->PopFrontLine();
+}
+void WIText::RecycleLineInfo(LineInfo &lineInfo)
+{
+	if(m_recycledLineInfo.has_value())
+		FreeGlyphRange(m_recycledLineInfo->glyphOffset,m_recycledLineInfo->glyphCapacity);
+	// The glyphs have to be hidden until the range is used by the next line
+	if(lineInfo.glyphCapacity > 0)
+	{
+		std::fill_n(m_glyphInstances.begin() +lineInfo.glyphOffset,lineInfo.glyphCapacity,GlyphInstance{});
+		MarkGlyphRangeDirty(lineInfo.glyphOffset,lineInfo.glyphCapacity);
+	}
+	m_recycledLineInfo = std::move(lineInfo);
+}
+WIText::LineInfo WIText::PopRecycledLineInfo()
+{
+	if(m_recycledLineInfo.has_value() == false)
+		return {};
+	// The glyph range and the capacity of the containers are kept, everything else is reset
+	auto lineInfo = std::move(*m_recycledLineInfo);
+	m_recycledLineInfo = {};
+	lineInfo.wpLine = {};
+	lineInfo.widthInPixels = 0;
+	lineInfo.bufferUpdateRequired = true;
+	lineInfo.dirty = false;
+	lineInfo.glyphSubLineIndexOffset = 0;
+	lineInfo.subLines.clear();
+	lineInfo.subLineOffsets.clear();
+	lineInfo.charPxOffsets.clear();
+	lineInfo.breakOffsets.clear();
+	lineInfo.colorSpans.clear();
+	lineInfo.metricsUpdateRequired = true;
+	return lineInfo;
+}
 void WIText::RemoveLine(util::text::LineIndex lineIdx) {m_text->RemoveLine(lineIdx);}
 bool WIText::RemoveText(util::text::LineIndex lineIdx,util::text::CharOffset charOffset,util::text::TextLength len)
 {
-	return m_text->RemoveText(lineIdx,charOffset,len);
+	BeginTextEdit();
+	auto result = m_text->RemoveText(lineIdx,charOffset,len);
+	EndTextEdit();
+	return result;
+}
+bool WIText::RemoveText(util::text::TextOffset offset,util::text::TextLength len)
+{
+	BeginTextEdit();
+	auto result = m_text->RemoveText(offset,len);
+	EndTextEdit();
+	return result;
 }
-bool WIText::RemoveText(util::text::TextOffset offset,util::text::TextLength len) {return m_text->RemoveText(offset,len);}
 bool WIText::MoveText(util::text::LineIndex lineIdx,util::text::CharOffset startOffset,util::text::TextLength len,util::text::LineIndex targetLineIdx,util::text::CharOffset targetCharOffset)
 {
 	return m_text->MoveText(lineIdx,startOffset,len,targetLineIdx,targetCharOffset);
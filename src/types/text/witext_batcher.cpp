@@ -0,0 +1,180 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx_wgui.h"
+#include "wgui/types/witext_batcher.hpp"
+#include "wgui/shaders/wishader_text.hpp"
+#include "wgui/fontmanager.h"
+#include "wgui/wiupload_manager.hpp"
+#include <prosper_context.hpp>
+#include <prosper_util.hpp>
+#include <prosper_command_buffer.hpp>
+#include <buffers/prosper_buffer.hpp>
+#include <prosper_descriptor_set_group.hpp>
+#include <image/prosper_texture.hpp>
+#include <algorithm>
+#include <cstring>
+
+void TextBatcher::Begin()
+{
+	m_active = true;
+}
+void TextBatcher::End()
+{
+	Flush();
+	ReleaseDrawDataDescriptorSets();
+	m_active = false;
+}
+bool TextBatcher::IsActive() const {return m_active;}
+bool TextBatcher::IsEmpty() const {return m_batches.empty();}
+void TextBatcher::Clear()
+{
+	m_batches.clear();
+	m_drawData.clear();
+	ReleaseDrawDataDescriptorSets();
+	m_active = false;
+}
+
+void TextBatcher::Add(
+	const std::shared_ptr<const FontInfo> &font,uint32_t lineHeight,uint32_t width,uint32_t height,const Mat4 &modelMatrix,const Vector4 &color,
+	const WIText::GlyphInstance *glyphs,const uint32_t *glyphBlockOrigins,const std::vector<std::pair<uint32_t,uint32_t>> &glyphRanges
+)
+{
+	if(font == nullptr || glyphRanges.empty())
+		return;
+	if(width != m_width || height != m_height)
+	{
+		// All glyphs of a batch have to share the same viewport
+		Flush();
+		m_width = width;
+		m_height = height;
+	}
+	// The line height is required to calculate the vertical glyph positions, so it has to be part of the batch
+	auto it = std::find_if(m_batches.begin(),m_batches.end(),[&font,lineHeight](const Batch &batch) {return batch.font == font && batch.lineHeight == lineHeight;});
+	if(it == m_batches.end())
+	{
+		m_batches.push_back({});
+		it = m_batches.end() -1;
+		it->font = font;
+		it->lineHeight = lineHeight;
+	}
+	auto &instances = it->instances;
+
+	uint32_t xScissor,yScissor,wScissor,hScissor;
+	WGUI::GetInstance().GetScissor(xScissor,yScissor,wScissor,hScissor);
+	auto drawIndex = static_cast<uint32_t>(m_drawData.size());
+	m_drawData.push_back({modelMatrix,color,Vector4{xScissor,yScissor,wScissor,hScissor}});
+	for(auto &range : glyphRanges)
+	{
+		instances.reserve(instances.size() +range.second);
+		for(auto i=range.first;i<range.first +range.second;++i)
+		{
+			auto &glyph = glyphs[i];
+			if(umath::is_flag_set(glyph.flags,WIText::GlyphInstance::Flags::Visible) == false)
+				continue; // Unused instance
+			instances.push_back({glyph,drawIndex});
+			// The batch shader expects absolute sub-line indices
+			instances.back().glyph.subLine += glyphBlockOrigins[i /WIText::GLYPH_RANGE_ALIGNMENT];
+		}
+	}
+}
+
+prosper::IDescriptorSetGroup *TextBatcher::GetDrawDataDescriptorSet(const std::shared_ptr<prosper::IBuffer> &buffer)
+{
+	auto it = std::find_if(m_drawDataDescriptorSets.begin(),m_drawDataDescriptorSets.end(),[&buffer](const DrawDataDescriptorSet &ds) {
+		return ds.buffer == buffer;
+	});
+	if(it != m_drawDataDescriptorSets.end())
+		return it->dsg.get();
+	auto dsg = WGUI::GetInstance().GetContext().CreateDescriptorSetGroup(wgui::ShaderTextBatch::DESCRIPTOR_SET_DRAW_DATA_BUFFER);
+	if(dsg == nullptr)
+		return nullptr;
+	dsg->GetDescriptorSet()->SetBindingStorageBuffer(*buffer,0u);
+	m_drawDataDescriptorSets.push_back({buffer,dsg});
+	return dsg.get();
+}
+
+void TextBatcher::ReleaseDrawDataDescriptorSets()
+{
+	// The descriptor sets reference the staging buffers, which could otherwise never be re-used by the upload manager
+	if(WGUI::IsOpen())
+	{
+		auto &context = WGUI::GetInstance().GetContext();
+		for(auto &ds : m_drawDataDescriptorSets)
+			context.KeepResourceAliveUntilPresentationComplete(ds.dsg);
+	}
+	m_drawDataDescriptorSets.clear();
+}
+
+void TextBatcher::Flush()
+{
+	if(m_batches.empty())
+		return;
+	auto batches = std::move(m_batches);
+	m_batches.clear();
+	auto drawData = std::move(m_drawData);
+	m_drawData.clear();
+	auto *shader = WGUI::GetInstance().GetTextBatchShader();
+	if(shader == nullptr)
+		return;
+	uint32_t numInstances = 0u;
+	for(auto &batch : batches)
+		numInstances += batch.instances.size();
+	if(numInstances == 0)
+		return;
+
+	// The data is written to host-coherent memory the GPU reads from directly, since no transfers or barriers can
+	// be recorded inside of the render pass
+	auto &uploadManager = WGUI::GetInstance().GetUploadManager();
+	std::shared_ptr<prosper::IBuffer> drawDataBuffer = nullptr;
+	prosper::DeviceSize drawDataOffset = 0;
+	auto *drawDataPtr = uploadManager.AllocateFrameData(drawData.size() *sizeof(DrawData),sizeof(DrawData),drawDataBuffer,drawDataOffset);
+	if(drawDataPtr == nullptr)
+		return;
+	memcpy(drawDataPtr,drawData.data(),drawData.size() *sizeof(DrawData));
+	auto *drawDataDsg = GetDrawDataDescriptorSet(drawDataBuffer);
+	if(drawDataDsg == nullptr)
+		return;
+
+	std::shared_ptr<prosper::IBuffer> instanceBuffer = nullptr;
+	prosper::DeviceSize instanceBufferOffset = 0;
+	auto *data = static_cast<uint8_t*>(uploadManager.AllocateFrameData(numInstances *sizeof(Instance),sizeof(uint32_t),instanceBuffer,instanceBufferOffset));
+	if(data == nullptr)
+		return;
+	std::vector<prosper::DeviceSize> batchOffsets {};
+	batchOffsets.reserve(batches.size());
+	for(auto &batch : batches)
+	{
+		batchOffsets.push_back(instanceBufferOffset);
+		auto size = batch.instances.size() *sizeof(Instance);
+		memcpy(data,batch.instances.data(),size);
+		data += size;
+		instanceBufferOffset += size;
+	}
+	auto &drawCmd = WGUI::GetInstance().GetContext().GetDrawCommandBuffer();
+	if(shader->BeginDraw(drawCmd,m_width,m_height) == false)
+		return;
+	// Clipping is done per instance
+	drawCmd->RecordSetScissor(m_width,m_height,0u,0u);
+	for(auto i=decltype(batches.size()){0u};i<batches.size();++i)
+	{
+		auto &batch = batches.at(i);
+		if(batch.instances.empty())
+			continue;
+		auto &font = *batch.font;
+		auto glyphMapExtents = font.GetGlyphMap()->GetImage().GetExtents();
+		wgui::ShaderTextBatch::PushConstants pushConstants {
+			{
+				1.f,1.f,glyphMapExtents.width,glyphMapExtents.height,font.GetMaxGlyphBitmapWidth(),
+				wgui::ShaderText::PackLineMetrics(batch.lineHeight,font.GetSize())
+			},
+			static_cast<uint32_t>(drawDataOffset /sizeof(DrawData))
+		};
+		shader->Draw(
+			*instanceBuffer,batchOffsets.at(i),*font.GetGlyphMapDescriptorSet(),*font.GetGlyphBoundsDescriptorSet(),*drawDataDsg->GetDescriptorSet(),
+			pushConstants,batch.instances.size()
+		);
+	}
+	shader->EndDraw();
+}
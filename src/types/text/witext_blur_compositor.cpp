@@ -0,0 +1,257 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx_wgui.h"
+#include "wgui/types/witext_blur_compositor.hpp"
+#include <prosper_context.hpp>
+#include <prosper_util.hpp>
+#include <prosper_render_pass.hpp>
+#include <prosper_command_buffer.hpp>
+#include <image/prosper_render_target.hpp>
+#include <image/prosper_texture.hpp>
+#include <shader/prosper_shader_blur.hpp>
+#include <image/prosper_sampler.hpp>
+#include <algorithm>
+
+bool TextBlurCompositor::Region::IsValid() const {return atlasRegion.IsValid();}
+
+uint32_t TextBlurCompositor::GetRegionPadding(float blurSize)
+{
+	// The blur samples BLUR_KERNEL_SIZE texels, which are spaced by the (reduced resolution) blur size
+	auto radius = (blurSize /static_cast<float>(RESOLUTION_DIVISOR)) *static_cast<float>(BLUR_KERNEL_SIZE /2u);
+	return umath::max(static_cast<uint32_t>(std::ceil(radius)) +1u,TextCacheAtlas::DEFAULT_REGION_PADDING);
+}
+
+TextBlurCompositor::TextBlurCompositor(prosper::IRenderPass &renderPass)
+	: m_renderPass{renderPass.shared_from_this()}
+{}
+
+TextBlurCompositor::Layer *TextBlurCompositor::FindLayer(float blurSize)
+{
+	auto it = std::find_if(m_layers.begin(),m_layers.end(),[blurSize](const Layer &layer) {
+		return layer.blurSize == blurSize;
+	});
+	return (it != m_layers.end()) ? &*it : nullptr;
+}
+const TextBlurCompositor::Layer *TextBlurCompositor::FindLayer(float blurSize) const {return const_cast<TextBlurCompositor*>(this)->FindLayer(blurSize);}
+
+bool TextBlurCompositor::IsValid(const Region &region) const
+{
+	auto *layer = FindLayer(region.blurSize);
+	return layer != nullptr && layer->atlas->IsValid(region.atlasRegion);
+}
+
+TextBlurCompositor::Page *TextBlurCompositor::FindPage(const Region &region)
+{
+	if(IsValid(region) == false)
+		return nullptr;
+	auto *layer = FindLayer(region.blurSize);
+	if(region.atlasRegion.page >= layer->pages.size())
+		return nullptr;
+	return &layer->pages.at(region.atlasRegion.page);
+}
+
+bool TextBlurCompositor::InitializePage(Page &page,const std::shared_ptr<prosper::RenderTarget> &rt)
+{
+	ReleasePage(page);
+	if(rt == nullptr)
+		return false;
+	// The blurred result is written to a separate image, so the sources remain intact
+	auto &context = WGUI::GetInstance().GetContext();
+	prosper::util::ImageCreateInfo createInfo {};
+	createInfo.width = PAGE_SIZE;
+	createInfo.height = PAGE_SIZE;
+	createInfo.format = prosper::Format::R8_UNorm;
+	createInfo.usage = prosper::ImageUsageFlags::SampledBit | prosper::ImageUsageFlags::ColorAttachmentBit;
+	createInfo.postCreateLayout = prosper::ImageLayout::ShaderReadOnlyOptimal;
+	auto img = context.CreateImage(createInfo);
+	if(img == nullptr)
+		return false;
+	auto imgViewCreateInfo = prosper::util::ImageViewCreateInfo {};
+	auto samplerCreateInfo = prosper::util::SamplerCreateInfo {};
+	samplerCreateInfo.addressModeU = samplerCreateInfo.addressModeV = prosper::SamplerAddressMode::ClampToEdge;
+	auto tex = context.CreateTexture({},*img,imgViewCreateInfo,samplerCreateInfo);
+	auto blurredRt = context.CreateRenderTarget({tex},m_renderPass);
+	if(blurredRt == nullptr)
+		return false;
+	blurredRt->SetDebugName("text_blur_page");
+	auto blurSet = prosper::BlurSet::Create(context,blurredRt,rt->GetTexture().shared_from_this());
+	if(blurSet == nullptr)
+		return false;
+	page.renderTarget = rt;
+	page.blurredRenderTarget = blurredRt;
+	page.blurSet = blurSet;
+	return true;
+}
+
+void TextBlurCompositor::ReleasePage(Page &page)
+{
+	if(page.blurSet != nullptr)
+	{
+		auto &context = WGUI::GetInstance().GetContext();
+		context.KeepResourceAliveUntilPresentationComplete(page.blurSet);
+		context.KeepResourceAliveUntilPresentationComplete(page.blurredRenderTarget);
+	}
+	page = {};
+}
+
+TextBlurCompositor::Region TextBlurCompositor::Allocate(float blurSize,uint32_t width,uint32_t height,const RenderFunction &fRender)
+{
+	if(blurSize <= 0.f)
+		return {};
+	auto *layer = FindLayer(blurSize);
+	if(layer == nullptr)
+	{
+		m_layers.push_back({});
+		layer = &m_layers.back();
+		layer->blurSize = blurSize;
+		layer->atlas = std::make_unique<TextCacheAtlas>(*m_renderPass,PAGE_SIZE,GetRegionPadding(blurSize));
+	}
+	width = umath::max((width +RESOLUTION_DIVISOR -1) /RESOLUTION_DIVISOR,1u);
+	height = umath::max((height +RESOLUTION_DIVISOR -1) /RESOLUTION_DIVISOR,1u);
+	Region region {};
+	region.blurSize = blurSize;
+	region.atlasRegion = layer->atlas->Allocate(width,height);
+	if(region.IsValid() == false)
+		return {};
+	if(layer->pages.size() < layer->atlas->GetPageCount())
+		layer->pages.resize(layer->atlas->GetPageCount());
+	auto &page = layer->pages.at(region.atlasRegion.page);
+	auto &rt = layer->atlas->GetPageRenderTarget(region.atlasRegion.page);
+	if(page.renderTarget != rt && InitializePage(page,rt) == false) // New page, or the slot of a page that has been released
+	{
+		layer->atlas->Free(region.atlasRegion);
+		return {};
+	}
+	page.sources[{region.atlasRegion.x,region.atlasRegion.y}] = {region.atlasRegion,fRender};
+	Invalidate(region);
+	return region;
+}
+
+void TextBlurCompositor::Free(Region &region)
+{
+	auto *page = FindPage(region);
+	if(page != nullptr)
+	{
+		SourceKey key {region.atlasRegion.x,region.atlasRegion.y};
+		page->sources.erase(key);
+		page->dirtySources.erase(key);
+		auto &atlas = *FindLayer(region.blurSize)->atlas;
+		// The freed region has to be cleared, otherwise its old contents would be blurred into the regions around it.
+		// Regions that are allocated at the same position later on are cleared when their source is rendered.
+		auto padding = atlas.GetRegionPadding();
+		auto &atlasRegion = region.atlasRegion;
+		page->clearRects.push_back({
+			atlasRegion.x,atlasRegion.y,
+			umath::min(atlasRegion.width +padding,PAGE_SIZE -atlasRegion.x),umath::min(atlasRegion.height +padding,PAGE_SIZE -atlasRegion.y)
+		});
+		page->dirty = true;
+		m_dirty = true;
+
+		auto pageIdx = atlasRegion.page;
+		atlas.Free(region.atlasRegion);
+		if(atlas.GetPageRenderTarget(pageIdx) == nullptr) // The atlas has released the page
+			ReleasePage(*page);
+	}
+	region = {};
+}
+
+void TextBlurCompositor::Invalidate(const Region &region)
+{
+	auto *page = FindPage(region);
+	if(page == nullptr)
+		return;
+	page->dirtySources.insert({region.atlasRegion.x,region.atlasRegion.y});
+	page->dirty = true;
+	m_dirty = true;
+}
+
+prosper::Texture *TextBlurCompositor::GetTexture(const Region &region) const
+{
+	auto *page = const_cast<TextBlurCompositor*>(this)->FindPage(region);
+	return (page != nullptr && page->blurredRenderTarget != nullptr) ? &page->blurredRenderTarget->GetTexture() : nullptr;
+}
+
+Vector4 TextBlurCompositor::GetUvRect(const Region &region) const
+{
+	auto *layer = FindLayer(region.blurSize);
+	if(layer == nullptr || region.IsValid() == false)
+		return {0.f,0.f,1.f,1.f};
+	return layer->atlas->GetUvRect(region.atlasRegion);
+}
+
+void TextBlurCompositor::FlushPage(Layer &layer,uint32_t pageIdx)
+{
+	auto &page = layer.pages.at(pageIdx);
+	page.dirty = false;
+	auto &rt = page.renderTarget;
+	if(rt == nullptr || page.blurSet == nullptr)
+		return;
+	auto &context = WGUI::GetInstance().GetContext();
+	auto drawCmd = context.GetDrawCommandBuffer();
+	auto &img = rt->GetTexture().GetImage();
+
+	if(page.initialized == false || page.clearRects.empty() == false)
+	{
+		drawCmd->RecordImageBarrier(
+			img,
+			prosper::PipelineStageFlags::FragmentShaderBit | prosper::PipelineStageFlags::ColorAttachmentOutputBit,prosper::PipelineStageFlags::ColorAttachmentOutputBit,
+			prosper::ImageLayout::ShaderReadOnlyOptimal,prosper::ImageLayout::ColorAttachmentOptimal,
+			prosper::AccessFlags::ShaderReadBit | prosper::AccessFlags::ColorAttachmentWriteBit,prosper::AccessFlags::ColorAttachmentWriteBit
+		);
+		drawCmd->RecordBeginRenderPass(*rt);
+			if(page.initialized == false)
+				drawCmd->RecordClearAttachment(img,std::array<float,4>{0.f,0.f,0.f,0.f});
+			else
+			{
+				for(auto &rect : page.clearRects)
+					TextCacheAtlas::RecordClearRegion(*drawCmd,img,rect.at(0),rect.at(1),rect.at(2),rect.at(3));
+			}
+		drawCmd->RecordEndRenderPass();
+		drawCmd->RecordImageBarrier(
+			img,
+			prosper::PipelineStageFlags::ColorAttachmentOutputBit,prosper::PipelineStageFlags::ColorAttachmentOutputBit | prosper::PipelineStageFlags::FragmentShaderBit,
+			prosper::ImageLayout::ShaderReadOnlyOptimal,prosper::ImageLayout::ShaderReadOnlyOptimal,
+			prosper::AccessFlags::ColorAttachmentWriteBit,prosper::AccessFlags::ColorAttachmentWriteBit | prosper::AccessFlags::ShaderReadBit
+		);
+		page.initialized = true;
+		page.clearRects.clear();
+	}
+
+	// Only the sources that have changed are re-rendered, the others are still intact in the source page
+	auto padding = layer.atlas->GetRegionPadding();
+	for(auto &key : page.dirtySources)
+	{
+		auto it = page.sources.find(key);
+		if(it == page.sources.end())
+			continue;
+		auto &region = it->second.first;
+		auto &fRender = it->second.second;
+		if(fRender != nullptr)
+			fRender(*rt,region.x,region.y,region.width,region.height,padding);
+	}
+	page.dirtySources.clear();
+
+	// The sources are rendered at a reduced resolution, so the blur size has to be scaled accordingly
+	prosper::util::record_blur_image(context,drawCmd,*page.blurSet,{
+		Vector4(2.f,1.f,1.f,1.f),
+		layer.blurSize /static_cast<float>(RESOLUTION_DIVISOR),
+		BLUR_KERNEL_SIZE
+	});
+}
+
+void TextBlurCompositor::Flush()
+{
+	if(m_dirty == false)
+		return;
+	m_dirty = false;
+	for(auto &layer : m_layers)
+	{
+		for(auto i=decltype(layer.pages.size()){0u};i<layer.pages.size();++i)
+		{
+			if(layer.pages.at(i).dirty)
+				FlushPage(layer,i);
+		}
+	}
+}
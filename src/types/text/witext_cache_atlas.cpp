@@ -0,0 +1,202 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx_wgui.h"
+#include "wgui/types/witext_cache_atlas.hpp"
+#include <prosper_context.hpp>
+#include <prosper_util.hpp>
+#include <prosper_render_pass.hpp>
+#include <prosper_command_buffer.hpp>
+#include <image/prosper_render_target.hpp>
+#include <image/prosper_texture.hpp>
+#include <image/prosper_sampler.hpp>
+#include <algorithm>
+
+bool TextCacheAtlas::Region::IsValid() const {return page != std::numeric_limits<uint32_t>::max();}
+
+void TextCacheAtlas::RecordClearRegion(prosper::ICommandBuffer &cmd,prosper::IImage &img,uint32_t x,uint32_t y,uint32_t width,uint32_t height)
+{
+	prosper::ClearArea clearArea {};
+	clearArea.rect.offset = {static_cast<int32_t>(x),static_cast<int32_t>(y)};
+	clearArea.rect.extent = {width,height};
+	cmd.RecordClearAttachment(img,std::array<float,4>{0.f,0.f,0.f,0.f},0u,clearArea);
+}
+
+static uint32_t s_atlasGeneration = 0u;
+TextCacheAtlas::TextCacheAtlas(prosper::IRenderPass &renderPass,uint32_t pageSize,uint32_t regionPadding)
+	: m_renderPass{renderPass.shared_from_this()},m_pageSize{pageSize},m_regionPadding{regionPadding},m_generation{++s_atlasGeneration}
+{}
+
+int32_t TextCacheAtlas::AddPage()
+{
+	auto &context = WGUI::GetInstance().GetContext();
+	prosper::util::ImageCreateInfo createInfo {};
+	createInfo.width = m_pageSize;
+	createInfo.height = m_pageSize;
+	createInfo.format = prosper::Format::R8_UNorm;
+	createInfo.usage = prosper::ImageUsageFlags::SampledBit | prosper::ImageUsageFlags::ColorAttachmentBit;
+	createInfo.postCreateLayout = prosper::ImageLayout::ShaderReadOnlyOptimal;
+	auto img = context.CreateImage(createInfo);
+	if(img == nullptr)
+		return -1;
+	auto imgViewCreateInfo = prosper::util::ImageViewCreateInfo {};
+	auto samplerCreateInfo = prosper::util::SamplerCreateInfo {};
+	samplerCreateInfo.addressModeU = samplerCreateInfo.addressModeV = prosper::SamplerAddressMode::ClampToEdge;
+	auto tex = context.CreateTexture({},*img,imgViewCreateInfo,samplerCreateInfo);
+	auto rt = context.CreateRenderTarget({tex},m_renderPass);
+	if(rt == nullptr)
+		return -1;
+	// Slots of released pages are re-used, so the page indices of existing regions remain valid
+	auto it = std::find_if(m_pages.begin(),m_pages.end(),[](const Page &page) {return page.renderTarget == nullptr;});
+	if(it == m_pages.end())
+	{
+		m_pages.push_back({});
+		it = m_pages.end() -1;
+	}
+	auto pageIdx = it -m_pages.begin();
+	rt->SetDebugName("text_cache_atlas_page_" +std::to_string(pageIdx));
+	*it = {};
+	it->renderTarget = rt;
+	return pageIdx;
+}
+
+bool TextCacheAtlas::AllocateInShelf(Shelf &shelf,uint32_t width,uint32_t &outX)
+{
+	// First fit
+	for(auto it=shelf.freeSpans.begin();it!=shelf.freeSpans.end();++it)
+	{
+		if(it->second < width)
+			continue;
+		outX = it->first;
+		it->first += width;
+		it->second -= width;
+		if(it->second == 0)
+			shelf.freeSpans.erase(it);
+		return true;
+	}
+	return false;
+}
+
+TextCacheAtlas::Region TextCacheAtlas::Allocate(uint32_t width,uint32_t height)
+{
+	auto paddedWidth = width +m_regionPadding;
+	auto shelfHeight = (height +m_regionPadding +SHELF_HEIGHT_GRANULARITY -1) /SHELF_HEIGHT_GRANULARITY *SHELF_HEIGHT_GRANULARITY;
+	if(width == 0 || height == 0 || paddedWidth > m_pageSize || shelfHeight > m_pageSize)
+		return {};
+	const auto fCreateRegion = [this,width,height](uint32_t pageIdx,uint32_t shelfIdx,uint32_t x) -> Region {
+		auto &page = m_pages.at(pageIdx);
+		++page.regionCount;
+		Region region {};
+		region.page = pageIdx;
+		region.shelf = shelfIdx;
+		region.x = x;
+		region.y = page.shelves.at(shelfIdx).y;
+		region.width = width;
+		region.height = height;
+		region.generation = m_generation;
+		return region;
+	};
+	// Existing shelves of the same height
+	for(auto pageIdx=decltype(m_pages.size()){0u};pageIdx<m_pages.size();++pageIdx)
+	{
+		auto &page = m_pages.at(pageIdx);
+		for(auto shelfIdx=decltype(page.shelves.size()){0u};shelfIdx<page.shelves.size();++shelfIdx)
+		{
+			auto &shelf = page.shelves.at(shelfIdx);
+			uint32_t x;
+			if(shelf.height != shelfHeight || AllocateInShelf(shelf,paddedWidth,x) == false)
+				continue;
+			return fCreateRegion(pageIdx,shelfIdx,x);
+		}
+	}
+	// New shelf
+	auto itPage = std::find_if(m_pages.begin(),m_pages.end(),[this,shelfHeight](const Page &page) {
+		return page.renderTarget != nullptr && page.shelfEnd +shelfHeight <= m_pageSize;
+	});
+	if(itPage == m_pages.end())
+	{
+		auto pageIdx = AddPage();
+		if(pageIdx == -1)
+			return {};
+		itPage = m_pages.begin() +pageIdx;
+	}
+	auto &page = *itPage;
+	page.shelves.push_back({});
+	auto &shelf = page.shelves.back();
+	shelf.y = page.shelfEnd;
+	shelf.height = shelfHeight;
+	shelf.freeSpans.push_back({paddedWidth,m_pageSize -paddedWidth});
+	page.shelfEnd += shelfHeight;
+	return fCreateRegion(itPage -m_pages.begin(),page.shelves.size() -1,0u);
+}
+
+bool TextCacheAtlas::IsValid(const Region &region) const
+{
+	return region.IsValid() && region.generation == m_generation && region.page < m_pages.size() && m_pages.at(region.page).renderTarget != nullptr;
+}
+
+void TextCacheAtlas::Free(Region &region)
+{
+	if(IsValid(region) == false)
+	{
+		region = {};
+		return;
+	}
+	auto &page = m_pages.at(region.page);
+	auto &shelf = page.shelves.at(region.shelf);
+	auto &spans = shelf.freeSpans;
+	std::pair<uint32_t,uint32_t> span {region.x,region.width +m_regionPadding};
+	auto it = std::lower_bound(spans.begin(),spans.end(),span);
+	it = spans.insert(it,span);
+	// Merge with adjacent free spans
+	if(it +1 != spans.end() && it->first +it->second == (it +1)->first)
+	{
+		it->second += (it +1)->second;
+		spans.erase(it +1);
+	}
+	if(it != spans.begin() && (it -1)->first +(it -1)->second == it->first)
+	{
+		(it -1)->second += it->second;
+		spans.erase(it);
+	}
+	--page.regionCount;
+	if(page.regionCount == 0)
+	{
+		// All regions of the page are unused, the shelves can be re-arranged
+		page.shelves.clear();
+		page.shelfEnd = 0u;
+		// The page is released, unless it's the only one left (to avoid re-creating it if a single cached text is re-allocated)
+		auto numPages = std::count_if(m_pages.begin(),m_pages.end(),[](const Page &page) {return page.renderTarget != nullptr;});
+		if(numPages > 1)
+		{
+			WGUI::GetInstance().GetContext().KeepResourceAliveUntilPresentationComplete(page.renderTarget);
+			page.renderTarget = nullptr;
+		}
+	}
+	region = {};
+}
+
+const std::shared_ptr<prosper::RenderTarget> &TextCacheAtlas::GetRenderTarget(const Region &region) const
+{
+	static std::shared_ptr<prosper::RenderTarget> nptr = nullptr;
+	return IsValid(region) ? m_pages.at(region.page).renderTarget : nptr;
+}
+const std::shared_ptr<prosper::RenderTarget> &TextCacheAtlas::GetPageRenderTarget(uint32_t pageIdx) const
+{
+	static std::shared_ptr<prosper::RenderTarget> nptr = nullptr;
+	return (pageIdx < m_pages.size()) ? m_pages.at(pageIdx).renderTarget : nptr;
+}
+
+Vector4 TextCacheAtlas::GetUvRect(const Region &region) const
+{
+	auto scale = 1.f /static_cast<float>(m_pageSize);
+	return {
+		region.x *scale,region.y *scale,
+		(region.x +region.width) *scale,(region.y +region.height) *scale
+	};
+}
+
+uint32_t TextCacheAtlas::GetPageCount() const {return m_pages.size();}
+uint32_t TextCacheAtlas::GetPageSize() const {return m_pageSize;}
+uint32_t TextCacheAtlas::GetRegionPadding() const {return m_regionPadding;}
@@ -0,0 +1,97 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx_wgui.h"
+#include "wgui/types/witext_edit_history.hpp"
+#include <algorithm>
+
+void TextEditHistory::Clear()
+{
+	m_edits.clear();
+	m_buffer.clear();
+	m_numApplied = 0;
+}
+void TextEditHistory::SetMaxBufferSize(size_t size)
+{
+	m_maxBufferSize = size;
+	Trim();
+}
+size_t TextEditHistory::GetMaxBufferSize() const {return m_maxBufferSize;}
+
+void TextEditHistory::Record(util::text::TextOffset offset,const std::string_view &removed,const std::string_view &inserted,bool merge)
+{
+	if(removed.empty() && inserted.empty())
+		return;
+	if(m_numApplied < m_edits.size())
+	{
+		// Edits that have been undone can't be redone anymore, their text can be released as well
+		m_edits.erase(m_edits.begin() +m_numApplied,m_edits.end());
+		m_buffer.resize(m_edits.empty() ? 0 : (m_edits.back().insertedOffset +m_edits.back().insertedLength));
+		merge = false;
+	}
+	if(merge && removed.empty() && m_edits.empty() == false)
+	{
+		auto &prevEdit = m_edits.back();
+		if(prevEdit.removedLength == 0 && prevEdit.offset +prevEdit.insertedLength == offset && prevEdit.insertedOffset +prevEdit.insertedLength == m_buffer.size())
+		{
+			m_buffer.append(inserted);
+			prevEdit.insertedLength += inserted.length();
+			Trim();
+			return;
+		}
+	}
+	Edit edit {};
+	edit.offset = offset;
+	edit.removedOffset = m_buffer.size();
+	edit.removedLength = removed.length();
+	m_buffer.append(removed);
+	edit.insertedOffset = m_buffer.size();
+	edit.insertedLength = inserted.length();
+	m_buffer.append(inserted);
+	m_edits.push_back(edit);
+	m_numApplied = m_edits.size();
+	Trim();
+}
+bool TextEditHistory::CanUndo() const {return m_numApplied > 0;}
+bool TextEditHistory::CanRedo() const {return m_numApplied < m_edits.size();}
+const TextEditHistory::Edit *TextEditHistory::Undo()
+{
+	if(CanUndo() == false)
+		return nullptr;
+	return &m_edits.at(--m_numApplied);
+}
+const TextEditHistory::Edit *TextEditHistory::Redo()
+{
+	if(CanRedo() == false)
+		return nullptr;
+	return &m_edits.at(m_numApplied++);
+}
+std::string_view TextEditHistory::GetRemovedText(const Edit &edit) const {return std::string_view{m_buffer}.substr(edit.removedOffset,edit.removedLength);}
+std::string_view TextEditHistory::GetInsertedText(const Edit &edit) const {return std::string_view{m_buffer}.substr(edit.insertedOffset,edit.insertedLength);}
+
+void TextEditHistory::Trim()
+{
+	if(m_buffer.size() <= m_maxBufferSize)
+		return;
+	// Discard the oldest edits until only half of the maximum size is in use, so the buffer doesn't
+	// have to be compacted again for every following edit
+	auto targetSize = m_maxBufferSize /2;
+	size_t numDiscarded = 0;
+	while(numDiscarded < m_edits.size() && m_buffer.size() -m_edits.at(numDiscarded).removedOffset > targetSize)
+		++numDiscarded;
+	if(numDiscarded == m_edits.size())
+	{
+		Clear();
+		return;
+	}
+	auto startOffset = m_edits.at(numDiscarded).removedOffset;
+	m_buffer.erase(0,startOffset);
+	m_edits.erase(m_edits.begin(),m_edits.begin() +numDiscarded);
+	for(auto &edit : m_edits)
+	{
+		edit.removedOffset -= startOffset;
+		edit.insertedOffset -= startOffset;
+	}
+	m_numApplied = (m_numApplied > numDiscarded) ? (m_numApplied -numDiscarded) : 0;
+}
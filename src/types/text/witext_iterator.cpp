@@ -14,14 +14,8 @@ TextLineIteratorBase::TextLineIteratorBase(WIText &text,util::text::LineIndex li
 	auto &lines = text.GetLines();
 	if(lineIndex >= lines.size())
 		return;
-	for(auto i=decltype(lineIndex){0u};i<lineIndex;++i)
-	{
-		auto &lineInfo = lines.at(i);
-		if(lineInfo.wpLine.expired())
-			continue;
-		auto pLine = lineInfo.wpLine.lock();
-		m_info.absLineStartOffset += pLine->GetAbsLength();
-	}
+	m_info.absSubLineIndex = text.GetSubLineIndexOffset(lineIndex);
+	m_info.absLineStartOffset = text.GetLineStartOffset(lineIndex);
 	if(subLineIndex > 0 && iterateSubLines == false)
 		throw std::logic_error{"Iterator skips sub-line but initial sub-line has been specified!"};
 	while(subLineIndex > 0)
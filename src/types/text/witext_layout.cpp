@@ -0,0 +1,238 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx_wgui.h"
+#include "wgui/types/witext_layout.hpp"
+#include <algorithm>
+
+FontMetrics::FontMetrics(uint32_t size,uint32_t maxGlyphSize,char firstChar,std::vector<Glyph> &&glyphs,int32_t monospaceAdvance)
+	: m_size{size},m_maxGlyphSize{maxGlyphSize},m_monospaceAdvance{monospaceAdvance},m_firstChar{firstChar},m_glyphs{std::move(glyphs)}
+{}
+const FontMetrics::Glyph *FontMetrics::GetGlyph(char c) const
+{
+	auto idx = static_cast<int32_t>(static_cast<uint8_t>(c)) -static_cast<int32_t>(static_cast<uint8_t>(m_firstChar));
+	if(idx < 0 || idx >= static_cast<int32_t>(m_glyphs.size()))
+		return nullptr;
+	auto &glyph = m_glyphs.at(idx);
+	return glyph.valid ? &glyph : nullptr;
+}
+uint32_t FontMetrics::GetSize() const {return m_size;}
+uint32_t FontMetrics::GetMaxGlyphSize() const {return m_maxGlyphSize;}
+bool FontMetrics::IsMonospace() const {return m_monospaceAdvance > 0;}
+int32_t FontMetrics::GetMonospaceAdvance() const {return m_monospaceAdvance;}
+
+/////////////
+
+uint32_t TextLayout::Line::GetSubLineCount() const {return subLines.empty() ? 1u : subLines.size();}
+uint32_t TextLayout::GetSubLineCount() const
+{
+	uint32_t count = 0u;
+	for(auto &line : lines)
+		count += line.GetSubLineCount();
+	return count;
+}
+
+/////////////
+
+uint32_t TextLayoutEngine::MeasureText(const FontMetrics &metrics,const std::string_view &text,uint32_t charOffset,int32_t *width,int32_t *height)
+{
+	if(metrics.IsMonospace() && height == nullptr)
+	{
+		// Every character with a glyph is one cell, no advances have to be summed up. Has to match the proportional path below.
+		auto offset = charOffset;
+		uint32_t numCells = 0u;
+		auto hasSpace = (metrics.GetGlyph(' ') != nullptr);
+		for(auto c : text)
+		{
+			if(c == '\t')
+			{
+				if(hasSpace == false)
+					continue;
+				auto tabWidth = TAB_WIDTH_SPACE_COUNT -(offset %TAB_WIDTH_SPACE_COUNT);
+				offset += tabWidth;
+				numCells += tabWidth;
+				continue;
+			}
+			if(metrics.GetGlyph(c) != nullptr)
+			{
+				++offset;
+				++numCells;
+			}
+			else if(c == '\n')
+				offset = 0u;
+		}
+		if(width != nullptr)
+			*width = static_cast<int32_t>(numCells) *metrics.GetMonospaceAdvance();
+		return offset -charOffset;
+	}
+	int32_t w = 0;
+	int32_t h = 0;
+	auto offset = charOffset;
+	for(auto c : text)
+	{
+		auto multiplier = 1u;
+		if(c == '\t')
+		{
+			c = ' ';
+			multiplier = TAB_WIDTH_SPACE_COUNT -(offset %TAB_WIDTH_SPACE_COUNT);
+		}
+		auto *glyph = metrics.GetGlyph(c);
+		if(glyph != nullptr)
+		{
+			w += glyph->advance *static_cast<int32_t>(multiplier);
+			h = std::max(h,glyph->height);
+			offset += multiplier;
+		}
+		if(c == '\n')
+			offset = 0u;
+	}
+	if(width != nullptr)
+		*width = w;
+	if(height != nullptr)
+		*height = h;
+	return offset -charOffset;
+}
+
+void TextLayoutEngine::ComputeCharOffsets(
+	const FontMetrics &metrics,const std::string_view &line,bool hidden,
+	std::vector<int32_t> &outPxOffsets,std::vector<util::text::CharOffset> &outBreakOffsets
+)
+{
+	outPxOffsets.clear();
+	outBreakOffsets.clear();
+	outPxOffsets.reserve(line.length() +1);
+	if(metrics.IsMonospace())
+	{
+		ComputeMonospaceCharOffsets(metrics,line,hidden,outPxOffsets,outBreakOffsets);
+		return;
+	}
+	int32_t pxOffset = 0;
+	uint32_t offset = 0u;
+	for(auto i=decltype(line.length()){0u};i<line.length();++i)
+	{
+		outPxOffsets.push_back(pxOffset);
+		auto c = hidden ? '*' : line.at(i);
+		if(c == ' ' || c == '\f' || c == '\v' || c == '\t')
+			outBreakOffsets.push_back(i +1);
+		// Has to match MeasureText
+		auto multiplier = 1u;
+		if(c == '\t')
+		{
+			multiplier = TAB_WIDTH_SPACE_COUNT -(offset %TAB_WIDTH_SPACE_COUNT);
+			c = ' ';
+		}
+		auto *glyph = metrics.GetGlyph(c);
+		if(glyph == nullptr)
+			continue;
+		pxOffset += glyph->advance *static_cast<int32_t>(multiplier);
+		offset += multiplier;
+	}
+	outPxOffsets.push_back(pxOffset);
+}
+
+void TextLayoutEngine::ComputeMonospaceCharOffsets(
+	const FontMetrics &metrics,const std::string_view &line,bool hidden,
+	std::vector<int32_t> &outPxOffsets,std::vector<util::text::CharOffset> &outBreakOffsets
+)
+{
+	auto advance = metrics.GetMonospaceAdvance();
+	outPxOffsets.resize(line.length() +1);
+	if(hidden)
+	{
+		// Every character is rendered as '*', so there's nothing to break at
+		if(metrics.GetGlyph('*') == nullptr)
+			advance = 0;
+		for(auto i=decltype(outPxOffsets.size()){0u};i<outPxOffsets.size();++i)
+			outPxOffsets[i] = static_cast<int32_t>(i) *advance;
+		return;
+	}
+	// Has to match MeasureText; Characters without a glyph don't occupy a cell
+	auto hasSpace = (metrics.GetGlyph(' ') != nullptr);
+	uint32_t offset = 0u;
+	for(auto i=decltype(line.length()){0u};i<line.length();++i)
+	{
+		outPxOffsets[i] = static_cast<int32_t>(offset) *advance;
+		auto c = line[i];
+		if(c == ' ' || c == '\f' || c == '\v' || c == '\t')
+			outBreakOffsets.push_back(i +1);
+		if(c == '\t')
+		{
+			if(hasSpace)
+				offset += TAB_WIDTH_SPACE_COUNT -(offset %TAB_WIDTH_SPACE_COUNT);
+			continue;
+		}
+		if(metrics.GetGlyph(c) != nullptr)
+			++offset;
+	}
+	outPxOffsets.back() = static_cast<int32_t>(offset) *advance;
+}
+
+void TextLayoutEngine::BreakLine(
+	const std::vector<int32_t> &pxOffsets,const std::vector<util::text::CharOffset> &breakOffsets,
+	int32_t width,BreakMode breakMode,std::vector<util::text::TextLength> &outSubLines
+)
+{
+	outSubLines.clear();
+	if(breakMode == BreakMode::None || width <= 0 || pxOffsets.empty() || pxOffsets.back() <= width)
+		return;
+	auto len = static_cast<util::text::TextLength>(pxOffsets.size() -1);
+	util::text::CharOffset startOffset = 0;
+	while(startOffset < len)
+	{
+		// Find the first character that exceeds the width
+		auto itEnd = std::upper_bound(pxOffsets.begin() +startOffset +1,pxOffsets.end(),pxOffsets.at(startOffset) +width);
+		auto endOffset = static_cast<util::text::CharOffset>(itEnd -pxOffsets.begin()) -1;
+		if(endOffset >= len)
+		{
+			outSubLines.push_back(len -startOffset);
+			break;
+		}
+		if(endOffset == startOffset)
+			++endOffset; // Character is wider than the available space; It will be out-of-bounds but there's nothing we can do
+		else if(breakMode == BreakMode::Whitespace)
+		{
+			// Break after the last whitespace character of this sub-line (if there is one)
+			auto itBreak = std::upper_bound(breakOffsets.begin(),breakOffsets.end(),endOffset);
+			if(itBreak != breakOffsets.begin() && *(itBreak -1) > startOffset)
+				endOffset = *(itBreak -1);
+		}
+		outSubLines.push_back(endOffset -startOffset);
+		startOffset = endOffset;
+	}
+}
+
+TextLayout TextLayoutEngine::Layout(const FontMetrics &metrics,const std::string_view &text,const Options &options)
+{
+	TextLayout layout {};
+	util::text::CharOffset lineStart = 0;
+	for(;;)
+	{
+		auto lineEnd = text.find('\n',lineStart);
+		auto strLine = text.substr(lineStart,(lineEnd != std::string_view::npos) ? (lineEnd -lineStart) : std::string_view::npos);
+		layout.lines.push_back({});
+		auto &line = layout.lines.back();
+		line.startOffset = lineStart;
+		line.length = strLine.length();
+		ComputeCharOffsets(metrics,strLine,options.hidden,line.charPxOffsets,line.breakOffsets);
+		BreakLine(line.charPxOffsets,line.breakOffsets,options.breakWidth,options.breakMode,line.subLines);
+		if(line.subLines.empty())
+			layout.width = std::max(layout.width,line.charPxOffsets.back());
+		else
+		{
+			util::text::CharOffset subLineStart = 0;
+			for(auto subLineLen : line.subLines)
+			{
+				layout.width = std::max(layout.width,line.charPxOffsets.at(subLineStart +subLineLen) -line.charPxOffsets.at(subLineStart));
+				subLineStart += subLineLen;
+			}
+		}
+		if(lineEnd == std::string_view::npos)
+			break;
+		lineStart = lineEnd +1;
+	}
+	// Has to match WIText::GetTextHeight
+	auto numLines = static_cast<int32_t>(layout.GetSubLineCount());
+	layout.height = numLines *static_cast<int32_t>(metrics.GetSize()) +(numLines -1) *options.breakHeight;
+	return layout;
+}
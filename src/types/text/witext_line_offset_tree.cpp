@@ -0,0 +1,112 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx_wgui.h"
+#include "wgui/types/witext_line_offset_tree.hpp"
+#include <algorithm>
+
+static size_t low_bit(size_t i) {return i &(~i +1);}
+
+void TextLineOffsetTree::Clear()
+{
+	m_values.clear();
+	m_tree.clear();
+	m_validCount = 0;
+	m_start = 0;
+}
+void TextLineOffsetTree::Assign(std::vector<uint32_t> &&values)
+{
+	m_values = std::move(values);
+	m_start = 0;
+	m_validCount = 0;
+}
+size_t TextLineOffsetTree::GetSize() const {return m_values.size() -m_start;}
+void TextLineOffsetTree::Insert(size_t index,uint32_t value)
+{
+	index = m_start +std::min(index,GetSize());
+	m_values.insert(m_values.begin() +index,value);
+	Invalidate(index);
+}
+void TextLineOffsetTree::Erase(size_t index)
+{
+	if(index >= GetSize())
+		return;
+	if(index == 0)
+	{
+		// The first entry is only skipped, so the tree remains valid. The skipped entries are removed
+		// once they outnumber the remaining ones, which keeps removing the first entry O(1) amortized.
+		++m_start;
+		if(m_start <= GetSize())
+			return;
+		m_values.erase(m_values.begin(),m_values.begin() +m_start);
+		m_start = 0;
+		Invalidate(0);
+		return;
+	}
+	index += m_start;
+	m_values.erase(m_values.begin() +index);
+	Invalidate(index);
+}
+void TextLineOffsetTree::Set(size_t index,uint32_t value)
+{
+	index += m_start;
+	auto &curValue = m_values.at(index);
+	if(value == curValue)
+		return;
+	// Unsigned overflow is intended here, the sums will still be correct
+	auto delta = value -curValue;
+	curValue = value;
+	for(auto i=index +1;i<=m_validCount;i += low_bit(i))
+		m_tree.at(i) += delta;
+}
+uint32_t TextLineOffsetTree::Get(size_t index) const {return m_values.at(m_start +index);}
+uint32_t TextLineOffsetTree::GetOffset(size_t index) const
+{
+	index = std::min(index,GetSize());
+	// Unsigned overflow is intended here as well
+	return GetPhysicalOffset(m_start +index) -GetPhysicalOffset(m_start);
+}
+uint32_t TextLineOffsetTree::GetTotal() const {return GetOffset(GetSize());}
+size_t TextLineOffsetTree::FindIndex(uint32_t offset) const
+{
+	offset += GetPhysicalOffset(m_start);
+	auto n = m_values.size();
+	Update(n);
+	size_t step = 1;
+	while((step <<1) <= n)
+		step <<= 1;
+	size_t index = 0;
+	for(;step > 0;step >>= 1)
+	{
+		if(index +step > n || m_tree.at(index +step) > offset)
+			continue;
+		index += step;
+		offset -= m_tree.at(index);
+	}
+	return std::max(index,m_start) -m_start;
+}
+uint32_t TextLineOffsetTree::GetPhysicalOffset(size_t index) const
+{
+	Update(index);
+	uint32_t offset = 0;
+	for(auto i=index;i>0;i -= low_bit(i))
+		offset += m_tree.at(i);
+	return offset;
+}
+void TextLineOffsetTree::Invalidate(size_t index) {m_validCount = std::min(m_validCount,index);}
+void TextLineOffsetTree::Update(size_t count) const
+{
+	if(count <= m_validCount)
+		return;
+	m_tree.resize(m_values.size() +1);
+	for(auto i=m_validCount +1;i<=count;++i)
+	{
+		// Each node contains the sum of its own value and the nodes it covers
+		auto sum = m_values.at(i -1);
+		for(size_t step=1;step<low_bit(i);step <<= 1)
+			sum += m_tree.at(i -step);
+		m_tree.at(i) = sum;
+	}
+	m_validCount = count;
+}
@@ -7,116 +7,216 @@
 #include "wgui/types/witext_tags.hpp"
 #include <util_formatted_text.hpp>
 #include <unordered_map>
+#include <algorithm>
+#include <numeric>
 
-void WIText::UpdateSubLines()
+void WIText::MarkLineDirty(util::text::LineIndex lineIdx)
 {
-	if(m_autoBreak == AutoBreak::NONE)
+	auto &lineInfo = m_lineInfos.at(lineIdx);
+	if(lineInfo.dirty)
 		return;
-	auto &lines = m_text->GetLines();
-	util::text::ShiftOffset lineShift = 0;
-	uint32_t curTagIdx = 0;
-	for(auto i=decltype(lines.size()){0u};i<lines.size();++i)
+	lineInfo.dirty = true;
+	m_dirtyLines.push_back(lineInfo.wpLine);
+}
+void WIText::MarkAllLinesDirty()
+{
+	for(auto i=decltype(m_lineInfos.size()){0u};i<m_lineInfos.size();++i)
+		MarkLineDirty(i);
+}
+void WIText::PopDirtyLines(std::vector<util::text::LineIndex> &lineIndices)
+{
+	lineIndices.clear();
+	lineIndices.reserve(m_dirtyLines.size());
+	for(auto &wpLine : m_dirtyLines)
 	{
-		if(BreakLineByWidth(i,lineShift) == false)
+		if(wpLine.expired())
+			continue; // Line has been removed
+		auto lineIdx = wpLine.lock()->GetIndex();
+		if(lineIdx >= m_lineInfos.size())
 			continue;
-		// Number of sub-lines have changed, we have to mark the tags associated with this line
-		// as dirty
-		auto &wpLine = m_lineInfos.at(i).wpLine;
-		if(curTagIdx >= m_tagInfos.size() || wpLine.expired())
+		auto &lineInfo = m_lineInfos.at(lineIdx);
+		if(lineInfo.dirty == false)
 			continue;
-		auto pLine = wpLine.lock();
-		auto lineEndOffset = pLine->GetAbsEndOffset();
-		m_flags |= Flags::ApplySubTextTags;
-		for(auto tagIdx=curTagIdx;tagIdx<m_tagInfos.size();++tagIdx)
-		{
-			auto &tag = m_tagInfos.at(tagIdx);
-			if(tag->GetStartTextCharOffset() > lineEndOffset)
-			{
-				curTagIdx = tagIdx;
-				break;
-			}
-			tag->SetDirty();
-		}
+		lineInfo.dirty = false;
+		lineIndices.push_back(lineIdx);
+	}
+	m_dirtyLines.clear();
+	std::sort(lineIndices.begin(),lineIndices.end());
+}
+void WIText::UpdateSubLines(std::vector<util::text::LineIndex> &inOutLineIndices)
+{
+	if(m_autoBreak == AutoBreak::NONE)
+		return;
+	auto w = GetWidth();
+	if(w != m_lineBreakWidth)
+	{
+		// Width has changed, all lines have to be re-broken
+		m_lineBreakWidth = w;
+		inOutLineIndices.resize(m_lineInfos.size());
+		std::iota(inOutLineIndices.begin(),inOutLineIndices.end(),0);
+	}
+	if(inOutLineIndices.empty())
+		return;
+	for(auto lineIdx : inOutLineIndices)
+	{
+		// Number of sub-lines have changed, we have to mark the tags associated with this line
+		// as dirty (tags on the following lines are updated by UpdateShiftedLines)
+		if(BreakLineByWidth(lineIdx))
+			MarkLineTagsDirty(lineIdx);
 	}
 	PerformTextPostProcessing();
 	CallCallbacks<void>("OnContentsChanged");
 }
-bool WIText::BreakLineByWidth(uint32_t lineIndex,util::text::ShiftOffset &lineShift)
+void WIText::UpdateLineMetrics(LineInfo &lineInfo)
 {
-	auto w = GetWidth();
-	if(m_autoBreak == AutoBreak::NONE || w == 0 || lineIndex >= m_lineInfos.size() || m_lineInfos.at(lineIndex).wpLine.expired())
-		return false;
+	lineInfo.metricsUpdateRequired = false;
+	auto &pxOffsets = lineInfo.charPxOffsets;
+	auto &breakOffsets = lineInfo.breakOffsets;
+	auto oldWidth = pxOffsets.empty() ? 0 : pxOffsets.back();
+	pxOffsets.clear();
+	breakOffsets.clear();
 	auto *font = GetFont();
-	auto &lineInfo = m_lineInfos.at(lineIndex);
-	auto line = lineInfo.wpLine.lock();
-	auto &strLine = line->GetFormattedLine().GetText();
-	auto strView = std::string_view{strLine};
-	auto len = line->GetAbsFormattedLength() -1;
-	auto i = line->GetAbsFormattedLength();
-	auto breakMode = m_autoBreak;
-	if(lineInfo.subLines.size() <= 1)
+	if(font == nullptr || font->GetMetrics() == nullptr || lineInfo.wpLine.expired())
+		pxOffsets.push_back(0);
+	else
 	{
-		// If we previously only had one line, the chance that we have to split the line is
-		// low. Perform a quick check to confirm and exit early if possible.
-		int wText = 0;
-		FontManager::GetTextSize(strLine,0u,font,&wText);
-		if(wText <= w)
-		{
-			// We're not updating the line buffers, so we have to change the
-			// line indices of the existing buffers
-			for(auto &bufInfo : lineInfo.buffers)
-				bufInfo.absLineIndex += lineShift;
-			return false;
-		}
+		auto line = lineInfo.wpLine.lock();
+		TextLayoutEngine::ComputeCharOffsets(*font->GetMetrics(),line->GetFormattedLine().GetText(),IsTextHidden(),pxOffsets,breakOffsets);
 	}
-	auto oldSubLines = lineInfo.subLines;
-	auto numSubLines = lineInfo.subLines.empty() ? 1 : lineInfo.subLines.size();
-	lineInfo.subLines.clear();
-	const auto fBreakLine = [this,w,&strView,&lineInfo,font](util::text::CharOffset charOffset) -> std::optional<util::text::CharOffset> {
-		auto startOffset = charOffset;
-		int32_t wText = 0;
-		auto lastSpaceCharOffset = util::text::LAST_CHAR;
-		while(charOffset < strView.length())
+
+	auto width = pxOffsets.back();
+	if(width >= m_maxLineWidth)
+		m_maxLineWidth = width;
+	else if(oldWidth >= m_maxLineWidth)
+		InvalidateMaxLineWidth(); // The widest line has become narrower
+}
+void WIText::MarkLineMetricsDirty(LineInfo &lineInfo)
+{
+	if(lineInfo.metricsUpdateRequired)
+		return; // Already queued
+	lineInfo.metricsUpdateRequired = true;
+	QueueLineMeasurement(lineInfo);
+}
+void WIText::QueueLineMeasurement(const LineInfo &lineInfo)
+{
+	if(m_maxLineWidthValid == false)
+		return;
+	// Lines that are changed repeatedly without being measured (e.g. in log mode) would make the queue grow indefinitely,
+	// in which case measuring the entire text once is cheaper
+	if(m_unmeasuredLines.size() >= m_lineInfos.size())
+	{
+		InvalidateMaxLineWidth();
+		return;
+	}
+	m_unmeasuredLines.push_back(lineInfo.wpLine);
+}
+void WIText::InvalidateMaxLineWidth()
+{
+	m_maxLineWidthValid = false;
+	m_unmeasuredLines.clear();
+}
+int32_t WIText::GetMaxLineWidth()
+{
+	if(m_maxLineWidthValid)
+	{
+		// Measuring a line may invalidate the maximum (and the queue), see UpdateLineMetrics
+		auto unmeasuredLines = std::move(m_unmeasuredLines);
+		m_unmeasuredLines.clear();
+		for(auto &wpLine : unmeasuredLines)
 		{
-			int32_t wChar = 0;
-			auto c = strView.at(charOffset);
-			FontManager::GetTextSize(c,0u,font,&wChar);
-			if(wText +wChar > w)
-			{
-				// Break
-				if(charOffset == 0)
-					return {}; // Don't break; Character will be out-of-bounds but there's nothing we can do
-				if(GetAutoBreakMode() == AutoBreak::WHITESPACE && lastSpaceCharOffset != util::text::LAST_CHAR)
-					charOffset = lastSpaceCharOffset +1;
-				lineInfo.subLines.push_back(charOffset -startOffset);
-				return charOffset;
-			}
-			if(c == ' ' || c == '\f' || c == '\v' || c == '\t')
-				lastSpaceCharOffset = charOffset;
-			wText += wChar;
-			++charOffset;
+			auto pLine = wpLine.lock();
+			if(pLine != nullptr)
+				GetUpdatedLineInfo(pLine->GetIndex());
 		}
-		if(charOffset > startOffset)
-			lineInfo.subLines.push_back(charOffset -startOffset);
-		return {};
-	};
-	std::optional<util::text::CharOffset> startOffset = 0;
-	while(startOffset.has_value())
-		startOffset = fBreakLine(*startOffset);
-	
-	auto newNumSubLines = lineInfo.subLines.size();
+		if(m_maxLineWidthValid)
+			return m_maxLineWidth;
+	}
+	int32_t maxWidth = 0;
+	for(auto lineIdx=decltype(m_lineInfos.size()){0u};lineIdx<m_lineInfos.size();++lineIdx)
+	{
+		auto *lineInfo = GetUpdatedLineInfo(lineIdx);
+		if(lineInfo != nullptr)
+			maxWidth = umath::max(maxWidth,lineInfo->charPxOffsets.back());
+	}
+	m_maxLineWidth = maxWidth;
+	m_maxLineWidthValid = true;
+	m_unmeasuredLines.clear();
+	return m_maxLineWidth;
+}
+WIText::LineInfo *WIText::GetUpdatedLineInfo(util::text::LineIndex lineIdx)
+{
+	if(lineIdx >= m_lineInfos.size())
+		return nullptr;
+	auto &lineInfo = m_lineInfos.at(lineIdx);
+	if(lineInfo.wpLine.expired())
+		return nullptr;
+	if(lineInfo.metricsUpdateRequired)
+		UpdateLineMetrics(lineInfo);
+	return &lineInfo;
+}
+void WIText::UpdateLineTextOffset(util::text::LineIndex lineIdx)
+{
+	if(lineIdx >= m_lineInfos.size())
+		return;
+	auto &lineInfo = m_lineInfos.at(lineIdx);
+	if(lineInfo.wpLine.expired())
+		return;
+	m_lineTextOffsets.Set(lineIdx,lineInfo.wpLine.lock()->GetAbsFormattedLength());
+}
+void WIText::InitializeLineOffsets()
+{
+	std::vector<uint32_t> subLineCounts {};
+	std::vector<uint32_t> lineLengths {};
+	subLineCounts.reserve(m_lineInfos.size());
+	lineLengths.reserve(m_lineInfos.size());
+	for(auto &lineInfo : m_lineInfos)
+	{
+		subLineCounts.push_back(lineInfo.subLines.empty() ? 1 : lineInfo.subLines.size());
+		lineLengths.push_back(lineInfo.wpLine.expired() ? 0 : lineInfo.wpLine.lock()->GetAbsFormattedLength());
+	}
+	m_subLineOffsets.Assign(std::move(subLineCounts));
+	m_lineTextOffsets.Assign(std::move(lineLengths));
+	m_firstShiftedLine = 0;
+	m_dirtyLines.reserve(m_dirtyLines.size() +m_lineInfos.size());
+	MarkAllLinesDirty();
+	SetFlag(Flags::ApplySubTextTags);
+	PerformTextPostProcessing();
+}
+void WIText::InvalidateLineMetrics()
+{
+	for(auto &lineInfo : m_lineInfos)
+	{
+		lineInfo.metricsUpdateRequired = true;
+		lineInfo.bufferUpdateRequired = true;
+	}
+	InvalidateMaxLineWidth();
+	MarkAllLinesDirty();
+	ScheduleRenderUpdate();
+}
+bool WIText::BreakLineByWidth(uint32_t lineIndex)
+{
+	auto w = GetWidth();
+	if(m_autoBreak == AutoBreak::NONE || w == 0 || lineIndex >= m_lineInfos.size() || m_lineInfos.at(lineIndex).wpLine.expired())
+		return false;
+	auto &lineInfo = m_lineInfos.at(lineIndex);
+	if(lineInfo.metricsUpdateRequired)
+		UpdateLineMetrics(lineInfo);
+	auto oldSubLines = std::move(lineInfo.subLines);
+	auto numSubLines = oldSubLines.empty() ? 1 : oldSubLines.size();
+	auto breakMode = (m_autoBreak == AutoBreak::WHITESPACE) ? TextLayoutEngine::BreakMode::Whitespace : TextLayoutEngine::BreakMode::Any;
+	TextLayoutEngine::BreakLine(lineInfo.charPxOffsets,lineInfo.breakOffsets,w,breakMode,lineInfo.subLines);
+	lineInfo.subLineOffsets.resize(lineInfo.subLines.size());
+	std::exclusive_scan(lineInfo.subLines.begin(),lineInfo.subLines.end(),lineInfo.subLineOffsets.begin(),util::text::CharOffset{0});
+
+	auto newNumSubLines = lineInfo.subLines.empty() ? 1 : lineInfo.subLines.size();
 	auto subLinesHaveChanged = newNumSubLines != numSubLines || lineInfo.subLines != oldSubLines;
 	if(subLinesHaveChanged)
 		lineInfo.bufferUpdateRequired = true;
-	else
+	if(newNumSubLines != numSubLines)
 	{
-		// Sublines haven't changed, no need to update the buffers.
-		// The line indices have to be updated manually, however.
-		for(auto &bufInfo : lineInfo.buffers)
-			bufInfo.absLineIndex += lineShift;
+		m_subLineOffsets.Set(lineIndex,newNumSubLines);
+		m_firstShiftedLine = umath::min<util::text::LineIndex>(m_firstShiftedLine,lineIndex +1);
 	}
-
-	lineShift += static_cast<util::text::ShiftOffset>(newNumSubLines) -static_cast<util::text::ShiftOffset>(numSubLines);
 	return subLinesHaveChanged;
 }
 
@@ -124,32 +224,62 @@ void WIText::SetText(const std::string_view &text)
 {
 	if(IsDirty() == false && *m_text == text)
 		return;
+	if(ReplaceLineText(text))
+		return;
 	umath::set_flag(m_flags,Flags::TextDirty,false);
 	umath::set_flag(m_flags,Flags::ApplySubTextTags);
 	ScheduleRenderUpdate(true);
-	std::string oldText = *m_text;
-	auto textCpy = text;
 
+	// The line callbacks only fill the line table during a bulk update, the line offsets and dirty lines are
+	// initialized in a single pass afterwards
+	BeginTextEdit();
+	umath::set_flag(m_flags,Flags::BulkTextUpdate);
 	m_text->Clear();
 	m_text->SetText(text);
+	ApplyLogLineCapacity();
+	umath::set_flag(m_flags,Flags::BulkTextUpdate,false);
+	InvalidateMaxLineWidth();
+	InitializeLineOffsets();
+	EndTextEdit();
 
-	std::string newText = *m_text;
-	CallCallbacks<void,std::reference_wrapper<const std::string>>("OnTextChanged",std::reference_wrapper<const std::string>(newText));
+	CallCallbacks<void,std::reference_wrapper<const std::string>>("OnTextChanged",std::reference_wrapper<const std::string>(GetText()));
 	CallCallbacks<void>("OnContentsChanged");
 }
+bool WIText::ReplaceLineText(const std::string_view &text)
+{
+	if(IsDirty() || AreTagsEnabled() || IsLogModeEnabled() || GetLineCount() != 1 || text.find('\n') != std::string_view::npos)
+		return false;
+	// Only the part between the common prefix and suffix is replaced, e.g. usually only the last digits of a counter
+	auto &oldText = GetText();
+	auto prefixLen = static_cast<util::text::TextLength>(std::mismatch(text.begin(),text.end(),oldText.begin(),oldText.end()).first -text.begin());
+	auto maxSuffixLen = umath::min<util::text::TextLength>(text.length(),oldText.length()) -prefixLen;
+	util::text::TextLength suffixLen = 0;
+	while(suffixLen < maxSuffixLen && text[text.length() -1 -suffixLen] == oldText[oldText.length() -1 -suffixLen])
+		++suffixLen;
+	auto numRemoved = static_cast<util::text::TextLength>(oldText.length()) -prefixLen -suffixLen;
+	auto inserted = text.substr(prefixLen,text.length() -prefixLen -suffixLen);
+
+	BeginTextEdit();
+	// Color spans are dropped, the same way they are when the line is re-created by a regular SetText
+	SetLineColorSpans(0,nullptr,0u);
+	if(numRemoved > 0)
+		RemoveText(0,prefixLen,numRemoved);
+	if(inserted.empty() == false)
+		InsertText(inserted,0,prefixLen);
+	EndTextEdit();
+
+	CallCallbacks<void,std::reference_wrapper<const std::string>>("OnTextChanged",std::reference_wrapper<const std::string>(GetText()));
+	CallCallbacks<void>("OnContentsChanged");
+	return true;
+}
 void WIText::PerformTextPostProcessing()
 {
-	for(auto lineIndex=decltype(m_lineInfos.size()){0u};lineIndex<m_lineInfos.size();++lineIndex)
+	if(m_textEditDepth > 0)
 	{
-		auto &lineInfo = m_lineInfos.at(lineIndex);
-		if(lineIndex == 0)
-			lineInfo.subLineIndexOffset = 0;
-		else
-		{
-			auto &prevLine = m_lineInfos.at(lineIndex -1);
-			lineInfo.subLineIndexOffset = prevLine.subLineIndexOffset +(prevLine.subLines.empty() ? 1 : prevLine.subLines.size());
-		}
+		SetFlag(Flags::PostProcessingPending);
+		return;
 	}
+	// Sub-line offsets are updated lazily by m_subLineOffsets
 	AutoSizeToText();
 }
 void WIText::AutoSizeToText()
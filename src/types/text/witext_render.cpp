@@ -5,49 +5,54 @@
 #include "stdafx_wgui.h"
 #include "wgui/types/witext.h"
 #include "wgui/types/witext_tags.hpp"
+#include "wgui/types/witext_batcher.hpp"
+#include "wgui/wiupload_manager.hpp"
 #include "wgui/shaders/wishader_text.hpp"
+#include "wgui/shaders/wishader_colored.hpp"
+#include "wgui/wielementdata.hpp"
 #include "wgui/types/wirect.h"
 #include <prosper_context.hpp>
 #include <image/prosper_sampler.hpp>
 #include <prosper_util.hpp>
 #include <prosper_util_square_shape.hpp>
-#include <shader/prosper_shader_blur.hpp>
 #include <prosper_command_buffer.hpp>
-#include <buffers/prosper_uniform_resizable_buffer.hpp>
-#include <sharedutils/scope_guard.h>
+#include <prosper_descriptor_set_group.hpp>
+#include <buffers/prosper_dynamic_resizable_buffer.hpp>
 #include <util_formatted_text.hpp>
+#include <cstring>
+#include <cmath>
 
-void WIText::InitializeBlur(bool bReload)
+static void set_uv_rect(WITexturedRect &rect,const Vector4 &uvRect)
 {
-	if(bReload == true)
-		DestroyBlur();
-	// Initialize blur temp buffers
-	if(m_shadowRenderTarget != nullptr)
-		m_shadowBlurSet = prosper::BlurSet::Create(WGUI::GetInstance().GetContext(),m_shadowRenderTarget);
-	//
+	auto uvs = prosper::util::get_square_uv_coordinates();
+	for(auto i=decltype(uvs.size()){0u};i<uvs.size();++i)
+	{
+		auto &uv = uvs.at(i);
+		rect.SetVertexUVCoord(i,{uvRect.x +(uvRect.z -uvRect.x) *uv.x,uvRect.y +(uvRect.w -uvRect.y) *uv.y});
+	}
+	rect.ScheduleUpdate();
 }
 
-void WIText::DestroyBlur() {m_shadowBlurSet = nullptr;}
-
 void WIText::InitializeShadow(bool bReload)
 {
 	if(bReload == true)
 		DestroyShadow();
-	auto &context = WGUI::GetInstance().GetContext();
-	prosper::util::ImageCreateInfo createInfo {};
-	createInfo.width = m_wTexture;
-	createInfo.height = m_hTexture;
-	createInfo.format = prosper::Format::R8_UNorm;
-	createInfo.usage = prosper::ImageUsageFlags::SampledBit | prosper::ImageUsageFlags::ColorAttachmentBit;
-	createInfo.postCreateLayout = prosper::ImageLayout::ShaderReadOnlyOptimal;
-	auto imgViewCreateInfo = prosper::util::ImageViewCreateInfo {};
-	auto samplerCreateInfo = prosper::util::SamplerCreateInfo {};
-	samplerCreateInfo.addressModeU = samplerCreateInfo.addressModeV = prosper::SamplerAddressMode::ClampToEdge;
-	auto img = context.CreateImage(createInfo);
-	auto tex = context.CreateTexture({},*img,imgViewCreateInfo,samplerCreateInfo);
-	auto &shader = static_cast<wgui::ShaderText&>(*m_shader.get());
-	auto &renderPass = shader.GetRenderPass();
-	m_shadowRenderTarget = context.CreateRenderTarget({tex},renderPass);
+	// The region is re-allocated if the compositor has been re-created in the meantime (see ClearTextBuffer)
+	if(m_shadow.blurSize > 0.f && (s_blurCompositor == nullptr || s_blurCompositor->IsValid(m_shadowBlurRegion) == false))
+	{
+		// Blurred shadows are rendered into a half-resolution page shared with all other blurred shadows of the same blur size,
+		// which is blurred once per frame (see FlushBlurredShadows). Unblurred shadows are displayed using the cached text itself.
+		if(s_blurCompositor == nullptr)
+		{
+			auto &shader = static_cast<wgui::ShaderText&>(*m_shader.get());
+			s_blurCompositor = std::make_unique<TextBlurCompositor>(shader.GetRenderPass());
+		}
+		auto hThis = GetHandle();
+		m_shadowBlurRegion = s_blurCompositor->Allocate(m_shadow.blurSize,m_wTexture,m_hTexture,[hThis](prosper::RenderTarget &rt,uint32_t x,uint32_t y,uint32_t w,uint32_t h,uint32_t padding) {
+			if(hThis.IsValid())
+				static_cast<WIText*>(hThis.get())->RenderCachedGlyphs(rt,x,y,w,h,padding);
+		});
+	}
 
 	if(!m_baseTextShadow.IsValid())
 	{
@@ -64,15 +69,22 @@ void WIText::InitializeShadow(bool bReload)
 			}
 		}
 	}
-	if(m_baseTextShadow.IsValid())
-	{
-		auto *rect = static_cast<WITexturedRect*>(m_baseTextShadow.get());
-		if(rect != nullptr)
-			rect->SetTexture(*tex);
-	}
 }
 
-void WIText::DestroyShadow() {m_shadowRenderTarget = nullptr;}
+void WIText::DestroyShadow()
+{
+	if(s_blurCompositor != nullptr)
+		s_blurCompositor->Free(m_shadowBlurRegion);
+	m_shadowBlurRegion = {};
+}
+
+void WIText::ReleaseCacheRegion()
+{
+	if(s_cacheAtlas != nullptr)
+		s_cacheAtlas->Free(m_cacheRegion);
+	m_cacheRegion = {};
+	m_renderTarget = nullptr;
+}
 
 void WIText::ScheduleRenderUpdate(bool bFull)
 {
@@ -88,12 +100,11 @@ void WIText::SetShadowBlurSize(float size)
 	if(size == m_shadow.blurSize)
 		return;
 	if(size > 0.f && IsCacheEnabled() == false)
-	{
 		SetCacheEnabled(true); // Cached images are required for blurred shadows
-		m_flags |= Flags::FullUpdateScheduled;
-	}
-	ScheduleRenderUpdate();
 	m_shadow.blurSize = size;
+	// The shadow has to be moved to the compositor pages of the new blur size
+	DestroyShadow();
+	ScheduleRenderUpdate(true);
 }
 float WIText::GetShadowBlurSize() {return m_shadow.blurSize;}
 void WIText::EnableShadow(bool b)
@@ -146,6 +157,23 @@ void WIText::SetShadowAlpha(float alpha)
 }
 float WIText::GetShadowAlpha() {return m_shadow.color.a;}
 
+void WIText::SetOutlineWidth(float width)
+{
+	if(m_outline.width == width)
+		return;
+	ScheduleRenderUpdate();
+	m_outline.width = width;
+}
+float WIText::GetOutlineWidth() const {return m_outline.width;}
+void WIText::SetOutlineColor(const Vector4 &col)
+{
+	if(m_outline.color == col)
+		return;
+	ScheduleRenderUpdate();
+	m_outline.color = col;
+}
+const Vector4 &WIText::GetOutlineColor() const {return m_outline.color;}
+
 void WIText::SelectShader()
 {
 	// Deprecated?
@@ -171,16 +199,24 @@ void WIText::UpdateRenderTexture()
 		if((m_flags &(Flags::RenderTextScheduled | Flags::FullUpdateScheduled)) != Flags::None)
 		{
 			m_flags &= ~(Flags::RenderTextScheduled | Flags::FullUpdateScheduled);
-			UpdateSubLines();
-			InitializeTextBuffers();
+			auto &lineIndices = m_dirtyLineIndices;
+			PopDirtyLines(lineIndices);
+			UpdateSubLines(lineIndices);
+			UpdateSubLineOrigin();
+			InitializeTextBuffers(lineIndices);
+			UpdateShiftedLines();
 		}
 		if((m_flags &Flags::ApplySubTextTags) != Flags::None)
 		{
 			m_flags &= ~Flags::ApplySubTextTags;
 			ApplySubTextTags();
 		}
+		UploadGlyphInstances();
 		return;
 	}
+	// The cached text is always rendered as a whole, the dirty lines only have to be drained
+	if(m_dirtyLines.empty() == false)
+		PopDirtyLines(m_dirtyLineIndices);
 	if(m_shader.expired())
 		return;
 	if((m_flags &Flags::RenderTextScheduled) != Flags::None && (m_flags &Flags::FullUpdateScheduled) == Flags::None)
@@ -203,49 +239,50 @@ void WIText::UpdateRenderTexture()
 	//	w = szMax;
 	//if(h > szMax)
 	//	h = szMax; // Vulkan TODO
+	auto sizeChanged = (static_cast<uint32_t>(w) != m_wTexture || static_cast<uint32_t>(h) != m_hTexture);
 	m_wTexture = w;
 	m_hTexture = h;
-	if(m_renderTarget != nullptr)
-		WGUI::GetInstance().GetContext().KeepResourceAliveUntilPresentationComplete(m_renderTarget);
-	m_renderTarget = nullptr;
-	DestroyShadow();
-	DestroyBlur();
+	// The blurred shadow keeps its compositor region if neither the size nor the blur size have changed,
+	// it's only invalidated by RenderText, so that its source is re-rendered with the next flush
+	if(sizeChanged || IsShadowEnabled() == false || m_shadowBlurRegion.blurSize != m_shadow.blurSize)
+		DestroyShadow();
 
-	if(m_wTexture == 0u || m_hTexture == 0u)
+	// The text is rendered into a region of a shared atlas page, which only has to be re-allocated if the size has changed
+	// (or if the atlas has been re-created in the meantime, see ClearTextBuffer)
+	if(s_cacheAtlas == nullptr || s_cacheAtlas->IsValid(m_cacheRegion) == false || m_cacheRegion.width != m_wTexture || m_cacheRegion.height != m_hTexture)
+	{
+		ReleaseCacheRegion();
+		if(s_cacheAtlas == nullptr)
+		{
+			auto &shader = static_cast<wgui::ShaderText&>(*m_shader.get());
+			s_cacheAtlas = std::make_unique<TextCacheAtlas>(shader.GetRenderPass());
+		}
+		m_cacheRegion = s_cacheAtlas->Allocate(m_wTexture,m_hTexture);
+		m_renderTarget = s_cacheAtlas->GetRenderTarget(m_cacheRegion);
+	}
+	if(m_renderTarget == nullptr) // Dimensions are most likely 0 or exceed the atlas page size
 		return;
-
-	auto imgCreateInfo = prosper::util::ImageCreateInfo {};
-	imgCreateInfo.width = m_wTexture;
-	imgCreateInfo.height = m_hTexture;
-	imgCreateInfo.format = prosper::Format::R8_UNorm;
-	imgCreateInfo.usage = prosper::ImageUsageFlags::SampledBit | prosper::ImageUsageFlags::ColorAttachmentBit;
-	imgCreateInfo.postCreateLayout = prosper::ImageLayout::ShaderReadOnlyOptimal;
-	
-	auto &context = WGUI::GetInstance().GetContext();
-	auto img = context.CreateImage(imgCreateInfo);
-	auto imgViewCreateInfo = prosper::util::ImageViewCreateInfo {};
-	auto samplerCreateInfo = prosper::util::SamplerCreateInfo {};
-	auto tex = context.CreateTexture({},*img,imgViewCreateInfo,samplerCreateInfo);
-	auto &shader = static_cast<wgui::ShaderText&>(*m_shader.get());
-	auto &renderPass = shader.GetRenderPass();
-	m_renderTarget = context.CreateRenderTarget({tex},renderPass);
 	if(IsShadowEnabled())
 		InitializeShadow();
-	InitializeBlur();
-	if(m_renderTarget == nullptr) // Dimensions are most likely 0
-		return;
-	if(m_baseEl.IsValid())
-	{
-		auto *el = static_cast<WITextBase*>(m_baseEl.get());
-		el->InitializeTexture(m_renderTarget->GetTexture(),w,h);
-	}
+	auto uvRect = GetTextureUvRect();
+	InitializeCacheRect(m_renderTarget->GetTexture(),w,h,uvRect);
 	if(m_baseTextShadow.IsValid())
 	{
 		WITexturedRect *text = m_baseTextShadow.get<WITexturedRect>();
 		if(text != NULL)
 		{
 			text->SetSize(w,h);
-			text->SetTexture(m_shadowRenderTarget->GetTexture());
+			auto *blurTex = (m_shadowBlurRegion.IsValid() && s_blurCompositor != nullptr) ? s_blurCompositor->GetTexture(m_shadowBlurRegion) : nullptr;
+			if(blurTex != nullptr)
+			{
+				text->SetTexture(*blurTex);
+				set_uv_rect(*text,s_blurCompositor->GetUvRect(m_shadowBlurRegion));
+			}
+			else
+			{
+				text->SetTexture(m_renderTarget->GetTexture());
+				set_uv_rect(*text,uvRect);
+			}
 		}
 	}
 
@@ -274,35 +311,38 @@ void WIText::RenderText()
 	RenderText(mat);
 }
 std::shared_ptr<prosper::Texture> WIText::GetTexture() const {return (m_renderTarget != nullptr) ? m_renderTarget->GetTexture().shared_from_this() : nullptr;}
+Vector4 WIText::GetTextureUvRect() const {return (s_cacheAtlas != nullptr && s_cacheAtlas->IsValid(m_cacheRegion)) ? s_cacheAtlas->GetUvRect(m_cacheRegion) : Vector4{0.f,0.f,1.f,1.f};}
 
-#pragma pack(push,1)
-struct GlyphBoundsInfo
-{
-	int32_t index;
-	Vector4 bounds;
-};
-#pragma pack(pop)
 void WIText::RenderText(Mat4&)
 {
 	if(m_font == nullptr || m_renderTarget == nullptr || m_shader.expired() || IsCacheEnabled() == false)
 		return;
+	RenderCachedGlyphs(*m_renderTarget,m_cacheRegion.x,m_cacheRegion.y,m_cacheRegion.width,m_cacheRegion.height,s_cacheAtlas->GetRegionPadding());
+
+	// The blurred shadow is rendered and blurred by the compositor at the end of the frame
+	if(m_shadow.enabled && s_blurCompositor != nullptr)
+		s_blurCompositor->Invalidate(m_shadowBlurRegion);
+
+	CallCallbacks<void,std::reference_wrapper<const std::shared_ptr<prosper::RenderTarget>>>("OnTextRendered",std::reference_wrapper<const std::shared_ptr<prosper::RenderTarget>>(m_renderTarget));
+}
+
+void WIText::RenderCachedGlyphs(prosper::RenderTarget &rt,uint32_t vpX,uint32_t vpY,uint32_t vpWidth,uint32_t vpHeight,uint32_t padding)
+{
+	if(m_font == nullptr || m_shader.expired() || m_wTexture == 0 || m_hTexture == 0)
+		return;
 	auto &context = WGUI::GetInstance().GetContext();
-	auto extents = m_renderTarget->GetTexture().GetImage().GetExtents();
-	auto w = extents.width;
-	auto h = extents.height;
+	// Glyph bounds are always calculated for the full resolution of the text; The viewport takes care of
+	// any scaling, which is required for the half-resolution blur sources.
+	auto w = m_wTexture;
+	auto h = m_hTexture;
 	auto sx = 2.f /float(w);
 	auto sy = 2.f /float(h);
-	//auto fontHeight = m_font->GetMaxGlyphTop();//m_font->GetMaxGlyphSize()
-	auto fontSize = m_font->GetSize();
 
 	// Initialize Buffers
-	float x = 0;
-	float y = 0;
+	int32_t x = 0;
 	auto numChars = m_text->GetCharCount();
-	std::vector<GlyphBoundsInfo> glyphBoundsInfos;
-	glyphBoundsInfos.reserve(numChars);
-	if(numChars == 0)
-		return;
+	std::vector<GlyphInstance> glyphInstances;
+	glyphInstances.reserve(numChars);
 	auto isHidden = IsTextHidden();
 	for(unsigned int i=0;i<m_lineInfos.size();i++)
 	{
@@ -318,303 +358,630 @@ void WIText::RenderText(Mat4&)
 			auto *glyph = m_font->GetGlyphInfo(c);
 			if(glyph != nullptr)
 			{
-				int32_t left,top,width,height;
-				glyph->GetDimensions(left,top,width,height);
 				int32_t advanceX,advanceY;
 				glyph->GetAdvance(advanceX,advanceY);
 
-				auto x2 = x +left *sx -1.f;
-				auto y2 = y -1.f -((top -static_cast<int>(fontSize))) *sy;
-				auto w = width *sx;
-				auto h = height *sy;
-
-				glyphBoundsInfos.push_back({});
-				auto &info = glyphBoundsInfos.back();
-				info.index = FontInfo::CharToGlyphMapIndex(c);
-				info.bounds = {x2,y2,width,height};
+				glyphInstances.push_back({});
+				auto &instance = glyphInstances.back();
+				instance.index = static_cast<uint16_t>(FontInfo::CharToGlyphMapIndex(c));
+				instance.x = static_cast<uint32_t>(umath::max(x,0));
+				instance.subLine = i;
+				instance.flags = GlyphInstance::Flags::Visible;
 
-				x += (advanceX >> 6) *sx;
-				y += (advanceY >> 6) *sy;
+				x += advanceX >> 6;
 			}
 		}
-		y += GetLineHeight() *sy;
 	}
-	numChars = glyphBoundsInfos.size();
-	assert(numChars != 0);
-	if(numChars == 0)
-		return;
-	prosper::util::BufferCreateInfo createInfo {};
-	createInfo.usageFlags = prosper::BufferUsageFlags::VertexBufferBit;
-	createInfo.memoryFeatures = prosper::MemoryFeatureFlags::DeviceLocal;
-	createInfo.size = glyphBoundsInfos.size() *sizeof(glyphBoundsInfos.front());
-
-	auto bufBounds = context.CreateBuffer(createInfo,glyphBoundsInfos.data());
-	context.KeepResourceAliveUntilPresentationComplete(bufBounds);
+	numChars = glyphInstances.size();
+	std::shared_ptr<prosper::IBuffer> bufBounds = nullptr;
+	if(numChars > 0)
+	{
+		prosper::util::BufferCreateInfo createInfo {};
+		createInfo.usageFlags = prosper::BufferUsageFlags::VertexBufferBit;
+		createInfo.memoryFeatures = prosper::MemoryFeatureFlags::DeviceLocal;
+		createInfo.size = glyphInstances.size() *sizeof(glyphInstances.front());
+		bufBounds = context.CreateBuffer(createInfo,glyphInstances.data());
+		context.KeepResourceAliveUntilPresentationComplete(bufBounds);
+	}
 
 	auto drawCmd = context.GetDrawCommandBuffer();
 	auto &shader = static_cast<wgui::ShaderText&>(*m_shader.get());
-	//prosper::util::record_set_viewport(*drawCmd,w,h);
-	//prosper::util::record_set_scissor(*drawCmd,w,h);
 
 	auto glyphMap = m_font->GetGlyphMap();
 	auto glyphMapExtents = glyphMap->GetImage().GetExtents();
 	auto maxGlyphBitmapWidth = m_font->GetMaxGlyphBitmapWidth();
 
 	wgui::ShaderText::PushConstants pushConstants {
-		sx,sy,glyphMapExtents.width,glyphMapExtents.height,maxGlyphBitmapWidth
+		sx,sy,glyphMapExtents.width,glyphMapExtents.height,maxGlyphBitmapWidth,
+		wgui::ShaderText::PackLineMetrics(GetLineHeight(),m_font->GetSize())
 	};
-	const auto fDraw = [&context,&drawCmd,&shader,&bufBounds,&pushConstants,sx,sy,numChars,w,h,this](prosper::RenderTarget &rt,bool bClear,uint32_t vpWidth,uint32_t vpHeight) {
-		auto &img = rt.GetTexture().GetImage();
-
-		drawCmd->RecordImageBarrier(
-			img,
-			prosper::PipelineStageFlags::FragmentShaderBit | prosper::PipelineStageFlags::ColorAttachmentOutputBit,prosper::PipelineStageFlags::ColorAttachmentOutputBit,
-			prosper::ImageLayout::ShaderReadOnlyOptimal,prosper::ImageLayout::ColorAttachmentOptimal,
-			prosper::AccessFlags::ShaderReadBit | prosper::AccessFlags::ColorAttachmentWriteBit,prosper::AccessFlags::ColorAttachmentWriteBit
+	auto &img = rt.GetTexture().GetImage();
+
+	drawCmd->RecordImageBarrier(
+		img,
+		prosper::PipelineStageFlags::FragmentShaderBit | prosper::PipelineStageFlags::ColorAttachmentOutputBit,prosper::PipelineStageFlags::ColorAttachmentOutputBit,
+		prosper::ImageLayout::ShaderReadOnlyOptimal,prosper::ImageLayout::ColorAttachmentOptimal,
+		prosper::AccessFlags::ShaderReadBit | prosper::AccessFlags::ColorAttachmentWriteBit,prosper::AccessFlags::ColorAttachmentWriteBit
+	);
+
+	drawCmd->RecordBeginRenderPass(rt);
+		// The region may still contain a previous text, so it has to be cleared first (including the padding, which
+		// is sampled when the region is filtered)
+		auto &imgExtents = img.GetExtents();
+		TextCacheAtlas::RecordClearRegion(
+			*drawCmd,img,vpX,vpY,
+			umath::min(vpWidth +padding,imgExtents.width -vpX),umath::min(vpHeight +padding,imgExtents.height -vpY)
 		);
+		if(bufBounds != nullptr && shader.BeginDraw(drawCmd,vpWidth,vpHeight) == true)
+		{
+			drawCmd->RecordSetViewport(vpWidth,vpHeight,vpX,vpY);
+			drawCmd->RecordSetScissor(vpWidth,vpHeight,vpX,vpY);
+			auto descSet = m_font->GetGlyphMapDescriptorSet();
+			shader.Draw(*bufBounds,*descSet,*m_font->GetGlyphBoundsDescriptorSet(),pushConstants,numChars);
+			shader.EndDraw();
+		}
+	drawCmd->RecordEndRenderPass();
+
+	drawCmd->RecordImageBarrier(
+		img,
+		prosper::PipelineStageFlags::ColorAttachmentOutputBit,prosper::PipelineStageFlags::ColorAttachmentOutputBit | prosper::PipelineStageFlags::FragmentShaderBit,
+		prosper::ImageLayout::ShaderReadOnlyOptimal,prosper::ImageLayout::ShaderReadOnlyOptimal,
+		prosper::AccessFlags::ColorAttachmentWriteBit,prosper::AccessFlags::ColorAttachmentWriteBit | prosper::AccessFlags::ShaderReadBit
+	);
+}
 
-		drawCmd->RecordBeginRenderPass(rt);
-			drawCmd->RecordClearAttachment(img,std::array<float,4>{0.f,0.f,0.f,0.f});
-			if(shader.BeginDraw(drawCmd,w,h) == true)
-			{
-				drawCmd->RecordSetViewport(vpWidth,vpHeight);
-				drawCmd->RecordSetScissor(vpWidth,vpHeight);
-				auto descSet = m_font->GetGlyphMapDescriptorSet();
-				shader.Draw(*bufBounds,*descSet,pushConstants,numChars);
-				shader.EndDraw();
-			}
-		drawCmd->RecordEndRenderPass();
+void WIText::InitializeTextBuffers(const std::vector<util::text::LineIndex> &lineIndices)
+{
+	auto virtualized = IsVirtualized();
+	auto materializedLineRange = virtualized ? GetMaterializedLineRange() : std::pair<util::text::LineIndex,util::text::LineIndex>{};
+	for(auto lineIdx : lineIndices)
+	{
+		auto &lineInfo = m_lineInfos.at(lineIdx);
+		if(lineInfo.bufferUpdateRequired == false)
+			continue;
+		if(virtualized && (lineIdx < materializedLineRange.first || lineIdx >= materializedLineRange.second))
+		{
+			// Line is out of view, buffers will be created once it becomes visible
+			ReleaseTextBuffers(lineInfo);
+			continue;
+		}
+		InitializeTextBuffers(lineInfo);
+	}
+	if(virtualized)
+		UpdateMaterializedLines();
+}
 
-		drawCmd->RecordImageBarrier(
-			img,
-			prosper::PipelineStageFlags::ColorAttachmentOutputBit,prosper::PipelineStageFlags::ColorAttachmentOutputBit | prosper::PipelineStageFlags::FragmentShaderBit,
-			prosper::ImageLayout::ShaderReadOnlyOptimal,prosper::ImageLayout::ShaderReadOnlyOptimal,
-			prosper::AccessFlags::ColorAttachmentWriteBit,prosper::AccessFlags::ColorAttachmentWriteBit | prosper::AccessFlags::ShaderReadBit
-		);
-	};
+void WIText::ReleaseTextBuffers(LineInfo &lineInfo)
+{
+	FreeGlyphRange(lineInfo.glyphOffset,lineInfo.glyphCapacity);
+	lineInfo.glyphCapacity = 0u;
+	lineInfo.bufferUpdateRequired = true;
+}
+
+std::pair<util::text::LineIndex,util::text::LineIndex> WIText::GetMaterializedLineRange() const
+{
+	auto numLines = static_cast<util::text::LineIndex>(m_lineInfos.size());
+	if(m_materializedSubLineRange.second <= m_materializedSubLineRange.first)
+		return {numLines,numLines};
+	auto startLineIdx = GetLineIndexFromSubLineIndex(m_materializedSubLineRange.first);
+	auto endLineIdx = GetLineIndexFromSubLineIndex(m_materializedSubLineRange.second -1);
+	return {startLineIdx,std::min<util::text::LineIndex>(endLineIdx +1,numLines)};
+}
+
+void WIText::SetVisibleSubLineRange(util::text::LineIndex startSubLineIdx,util::text::LineIndex endSubLineIdx)
+{
+	auto &curRange = m_materializedSubLineRange;
+	if(startSubLineIdx >= curRange.first && endSubLineIdx <= curRange.second && curRange.second > curRange.first)
+		return;
+	// Include one page above and below the visible lines, so we don't have to update the buffers
+	// every time the text is scrolled
+	auto numSubLines = endSubLineIdx -startSubLineIdx;
+	curRange = {(startSubLineIdx > numSubLines) ? (startSubLineIdx -numSubLines) : 0,endSubLineIdx +numSubLines};
+	ScheduleRenderUpdate();
+}
+
+void WIText::UpdateVisibleSubLineRange()
+{
+	// The visible part of the text is determined by the ancestors the text is clipped to (see WIBase::Draw). It's resolved
+	// before the text buffers are updated, so lines that have been scrolled into view are rendered in the same frame.
+	auto lineHeight = (m_font != nullptr) ? GetLineHeight() : 0;
+	if(lineHeight <= 0)
+		return;
+	auto absPos = GetAbsolutePos();
+	auto yStart = absPos.y;
+	auto yEnd = absPos.y +GetHeight();
+	WIBase *el = this;
+	while(el->GetShouldScissor())
+	{
+		auto *parent = el->GetParent();
+		if(parent == nullptr)
+			break;
+		auto parentPos = parent->GetAbsolutePos();
+		yStart = umath::max(yStart,parentPos.y);
+		yEnd = umath::min(yEnd,parentPos.y +parent->GetHeight());
+		el = parent;
+	}
+	if(yEnd <= yStart)
+		return; // Not visible, keep the current range
+	SetVisibleSubLineRange((yStart -absPos.y) /lineHeight,(yEnd -absPos.y) /lineHeight +1);
+}
+
+void WIText::UpdateMaterializedLines()
+{
+	auto materializedLineRange = GetMaterializedLineRange();
+	for(auto &wpLine : m_materializedLines)
+	{
+		if(wpLine.expired())
+			continue;
+		auto lineIdx = wpLine.lock()->GetIndex();
+		if(lineIdx >= m_lineInfos.size() || (lineIdx >= materializedLineRange.first && lineIdx < materializedLineRange.second))
+			continue;
+		ReleaseTextBuffers(m_lineInfos.at(lineIdx));
+	}
+	m_materializedLines.clear();
+	m_materializedLines.reserve(materializedLineRange.second -materializedLineRange.first);
+	for(auto lineIdx=materializedLineRange.first;lineIdx<materializedLineRange.second;++lineIdx)
+	{
+		auto &lineInfo = m_lineInfos.at(lineIdx);
+		if(lineInfo.bufferUpdateRequired)
+			InitializeTextBuffers(lineInfo); // Also marks the tags of the line dirty, if glyph colors have to be re-applied
+		m_materializedLines.push_back(lineInfo.wpLine);
+	}
+}
 
-	// Render Shadow
-	if(m_shadow.enabled)
+void WIText::InitializeTextBuffers(LineInfo &lineInfo)
+{
+	lineInfo.bufferUpdateRequired = false;
+	if(lineInfo.wpLine.expired() == true || m_font == nullptr)
+	{
+		FreeGlyphRange(lineInfo.glyphOffset,lineInfo.glyphCapacity);
+		lineInfo.glyphCapacity = 0u;
+		return;
+	}
+	auto pLine = lineInfo.wpLine.lock();
+	auto lineView = std::string_view{pLine->GetFormattedLine()};
+	auto lineLength = static_cast<util::text::TextLength>(lineView.length());
+
+	// Every character gets one instance, so the instance of a character can be found through its offset
+	auto newSlot = false;
+	if(lineLength > lineInfo.glyphCapacity || (lineLength == 0 && lineInfo.glyphCapacity > 0))
+	{
+		FreeGlyphRange(lineInfo.glyphOffset,lineInfo.glyphCapacity);
+		lineInfo.glyphCapacity = (lineLength > 0) ? ((lineLength +GLYPH_RANGE_ALIGNMENT -1) /GLYPH_RANGE_ALIGNMENT *GLYPH_RANGE_ALIGNMENT) : 0u;
+		lineInfo.glyphOffset = (lineInfo.glyphCapacity > 0) ? AllocateGlyphRange(lineInfo.glyphCapacity) : 0u;
+		newSlot = true;
+	}
+	if(lineInfo.glyphCapacity == 0)
+		return;
+	// The vertical position of the line is only stored in the origins of its glyph blocks
+	SetGlyphBlockOrigin(lineInfo,m_subLineOrigin +GetSubLineIndexOffset(pLine->GetIndex()));
+
+	// The pen positions have already been calculated for the line metrics, so they only have to be made relative to the sub-line
+	if(lineInfo.metricsUpdateRequired)
+		UpdateLineMetrics(lineInfo);
+	auto &pxOffsets = lineInfo.charPxOffsets;
+	auto &glyphInstances = m_lineGlyphInstances;
+	glyphInstances.assign(lineInfo.glyphCapacity,GlyphInstance{});
+	auto isHidden = IsTextHidden();
+	util::text::LineIndex subLineIdx = 0;
+	util::text::CharOffset subLineStartOffset = 0;
+	util::text::CharOffset subLineEndOffset = lineInfo.subLines.empty() ? lineLength : lineInfo.subLines.front();
+	auto numChars = umath::min<util::text::TextLength>(lineLength,(pxOffsets.size() > 0) ? (pxOffsets.size() -1) : 0);
+	for(auto i=decltype(numChars){0u};i<numChars;++i)
 	{
-		fDraw(*m_shadowRenderTarget,true,w,h); // TODO: Render text shadow shadow at the same time? (Single framebuffer)
+		while(i >= subLineEndOffset && subLineIdx +1 < lineInfo.subLines.size())
+		{
+			subLineStartOffset = subLineEndOffset;
+			subLineEndOffset += lineInfo.subLines.at(++subLineIdx);
+		}
+		auto c = isHidden ? '*' : lineView.at(i);
+		if(c == '\t')
+			c = ' ';
+		if(m_font->GetGlyphInfo(c) == nullptr)
+			continue;
+		// Positions are in pixels relative to the element (see RenderLines)
+		auto x = pxOffsets.at(i) -pxOffsets.at(subLineStartOffset);
+		auto &instance = glyphInstances.at(i);
+		instance.index = static_cast<uint16_t>(FontInfo::CharToGlyphMapIndex(c));
+		instance.x = static_cast<uint32_t>(umath::max(x,0));
+		instance.subLine = static_cast<uint32_t>(subLineIdx);
+		instance.flags = GlyphInstance::Flags::Visible;
+	}
+
+	ApplyColorSpans(lineInfo,glyphInstances.data(),glyphInstances.size());
 
-		if(m_shadow.blurSize != 0.f && m_shadowBlurSet != nullptr)
+	// Only upload the instances that have actually changed
+	auto itDst = m_glyphInstances.begin() +lineInfo.glyphOffset;
+	if(newSlot)
+	{
+		std::copy(glyphInstances.begin(),glyphInstances.end(),itDst);
+		MarkGlyphRangeDirty(lineInfo.glyphOffset,lineInfo.glyphCapacity);
+	}
+	else
+	{
+		const auto fEqual = [](const GlyphInstance &a,const GlyphInstance &b) {return memcmp(&a,&b,sizeof(a)) == 0;};
+		auto itFirst = std::mismatch(glyphInstances.begin(),glyphInstances.end(),itDst,fEqual).first;
+		if(itFirst != glyphInstances.end())
 		{
-			prosper::util::record_blur_image(context,drawCmd,*m_shadowBlurSet,{
-				Vector4(2.f,1.f,1.f,1.f),
-				m_shadow.blurSize,
-				9
-			});
+			auto itLast = std::mismatch(glyphInstances.rbegin(),glyphInstances.rend(),std::make_reverse_iterator(itDst +glyphInstances.size()),fEqual).first.base();
+			auto first = static_cast<uint32_t>(itFirst -glyphInstances.begin());
+			auto count = static_cast<uint32_t>(itLast -itFirst);
+			std::copy(itFirst,itLast,itDst +first);
+			MarkGlyphRangeDirty(lineInfo.glyphOffset +first,count);
 		}
-		//prosper::util::record_set_viewport(*drawCmd,m_wTexture,m_hTexture);
 	}
-	//
-	
-	// Render Text
-	fDraw(*m_renderTarget,false,w,h);
-	//
+	if(umath::is_flag_set(m_flags,Flags::HasGlyphColors))
+		MarkLineTagsDirty(pLine->GetIndex()); // Colors will be re-applied by the tags
+}
 
-	CallCallbacks<void,std::reference_wrapper<const std::shared_ptr<prosper::RenderTarget>>>("OnTextRendered",std::reference_wrapper<const std::shared_ptr<prosper::RenderTarget>>(m_renderTarget));
+void WIText::UpdateShiftedLines()
+{
+	MarkShiftedDecoratorsDirty(m_firstShiftedLine);
 
-	//uto windowSize = context.GetWindowSize();
-	//prosper::util::record_set_viewport(*drawCmd,windowSize.at(0),windowSize.at(1));
-	//prosper::util::record_set_scissor(*drawCmd,windowSize.at(0),windowSize.at(1));
+	auto numLines = static_cast<util::text::LineIndex>(m_lineInfos.size());
+	if(m_firstShiftedLine < numLines)
+	{
+		// Lines below inserted, removed or re-broken lines have moved vertically, which only affects the origins of their glyph blocks
+		auto subLineIndexOffset = m_subLineOrigin +GetSubLineIndexOffset(m_firstShiftedLine);
+		for(auto lineIdx=m_firstShiftedLine;lineIdx<numLines;++lineIdx)
+		{
+			auto &lineInfo = m_lineInfos.at(lineIdx);
+			if(lineInfo.glyphCapacity > 0 && lineInfo.bufferUpdateRequired == false && lineInfo.glyphSubLineIndexOffset != subLineIndexOffset)
+				SetGlyphBlockOrigin(lineInfo,subLineIndexOffset);
+			subLineIndexOffset += m_subLineOffsets.Get(lineIdx);
+		}
+	}
+	m_firstShiftedLine = std::numeric_limits<util::text::LineIndex>::max();
 }
 
-void WIText::InitializeTextBuffers()
+void WIText::CollectVisibleGlyphRanges(
+	int32_t xStart,int32_t yStart,int32_t xEnd,int32_t yEnd,int32_t margin,
+	std::vector<std::pair<uint32_t,uint32_t>> &outRanges
+) const
 {
-	util::text::LineIndex lineIndex = 0;
-	for(auto &lineInfo : m_lineInfos)
+	outRanges.clear();
+	auto lineHeight = (m_font != nullptr) ? GetLineHeight() : 0;
+	auto numSubLines = GetTotalLineCount();
+	if(lineHeight <= 0 || numSubLines == 0 || xEnd < xStart || yEnd < yStart)
+		return;
+	auto startSubLineIdx = static_cast<util::text::LineIndex>(umath::max(yStart -margin,0) /lineHeight);
+	auto endSubLineIdx = umath::min(static_cast<util::text::LineIndex>(umath::max(yEnd +margin,0) /lineHeight +1),numSubLines);
+	if(startSubLineIdx >= endSubLineIdx)
+		return;
+	const auto fAddRange = [&outRanges](uint32_t offset,uint32_t count) {
+		if(count == 0)
+			return;
+		if(outRanges.empty() == false && outRanges.back().first +outRanges.back().second == offset)
+			outRanges.back().second += count;
+		else
+			outRanges.push_back({offset,count});
+	};
+	// The first and last visible lines are found through the sub-line offsets, so only the visible lines have to be visited
+	auto startLineIdx = GetLineIndexFromSubLineIndex(startSubLineIdx);
+	auto endLineIdx = umath::min<util::text::LineIndex>(GetLineIndexFromSubLineIndex(endSubLineIdx -1) +1,m_lineInfos.size());
+	auto lineSubLineIdx = GetSubLineIndexOffset(startLineIdx);
+	for(auto lineIdx=startLineIdx;lineIdx<endLineIdx;lineSubLineIdx += m_subLineOffsets.Get(lineIdx++))
 	{
-		if(lineInfo.bufferUpdateRequired == true)
-			InitializeTextBuffers(lineInfo,lineIndex);
+		auto &lineInfo = m_lineInfos.at(lineIdx);
+		if(lineInfo.glyphCapacity == 0)
+			continue;
+		auto &pxOffsets = lineInfo.charPxOffsets;
+		if(lineInfo.metricsUpdateRequired || pxOffsets.empty())
+		{
+			fAddRange(lineInfo.glyphOffset,lineInfo.glyphCapacity);
+			continue;
+		}
+		auto len = umath::min<uint32_t>(lineInfo.glyphCapacity,pxOffsets.size() -1);
 		if(lineInfo.subLines.empty() == false)
-			lineIndex += lineInfo.subLines.size();
+		{
+			// Broken lines fit into the element horizontally, but only some of their sub-lines may be visible
+			auto &subLineOffsets = lineInfo.subLineOffsets;
+			auto firstSubLine = (startSubLineIdx > lineSubLineIdx) ? (startSubLineIdx -lineSubLineIdx) : 0;
+			auto endSubLine = endSubLineIdx -lineSubLineIdx;
+			auto startOffset = umath::min<uint32_t>((firstSubLine < subLineOffsets.size()) ? subLineOffsets.at(firstSubLine) : len,len);
+			auto endOffset = umath::min<uint32_t>((endSubLine < subLineOffsets.size()) ? subLineOffsets.at(endSubLine) : len,len);
+			if(endOffset > startOffset)
+				fAddRange(lineInfo.glyphOffset +startOffset,endOffset -startOffset);
+			continue;
+		}
+		// Glyphs of long lines are culled horizontally in chunks, starting with the chunk that contains the first visible character
+		auto itStart = std::upper_bound(pxOffsets.begin(),pxOffsets.begin() +len,xStart -margin);
+		auto startOffset = static_cast<uint32_t>(umath::max<int64_t>((itStart -pxOffsets.begin()) -1,0));
+		for(auto offset=startOffset /GLYPH_CULL_CHUNK_SIZE *GLYPH_CULL_CHUNK_SIZE;offset<len;offset += GLYPH_CULL_CHUNK_SIZE)
+		{
+			if(pxOffsets.at(offset) -margin > xEnd)
+				break;
+			fAddRange(lineInfo.glyphOffset +offset,umath::min(offset +GLYPH_CULL_CHUNK_SIZE,len) -offset);
+		}
+	}
+	if(outRanges.size() < 2)
+		return;
+	// Lines don't necessarily occupy the glyph buffer in order
+	std::sort(outRanges.begin(),outRanges.end());
+	auto itDst = outRanges.begin();
+	for(auto it=outRanges.begin() +1;it!=outRanges.end();++it)
+	{
+		if(itDst->first +itDst->second == it->first)
+			itDst->second += it->second;
 		else
-			++lineIndex;
+			*(++itDst) = *it;
 	}
+	outRanges.erase(itDst +1,outRanges.end());
 }
 
-void WIText::InitializeTextBuffers(LineInfo &lineInfo,util::text::LineIndex lineIndex)
+void WIText::UpdateSubLineOrigin()
 {
-	lineInfo.bufferUpdateRequired = false;
-	if(lineInfo.wpLine.expired() == true)
+	// The origin is applied as a floating point translation in pixels (see RenderLines), which is only exact up to 2^24.
+	// If the origin has moved too far, all lines are moved back to an origin of 0, which only happens every few hundred
+	// thousand removed lines in log mode.
+	if(m_subLineOrigin == 0 || static_cast<uint64_t>(m_subLineOrigin) *GetLineHeight() < (1ull<<24ull))
+		return;
+	m_subLineOrigin = 0;
+	m_firstShiftedLine = 0; // Also updates the decoration quads, which are relative to the origin
+}
+
+uint32_t WIText::AllocateGlyphRange(uint32_t count)
+{
+	// First fit, the lowest offset is preferred (see FreeGlyphRange)
+	for(auto it=m_freeGlyphRanges.begin();it!=m_freeGlyphRanges.end();++it)
 	{
-		lineInfo.buffers.clear();
+		if(it->second < count)
+			continue;
+		auto offset = it->first;
+		it->first += count;
+		it->second -= count;
+		if(it->second == 0)
+			m_freeGlyphRanges.erase(it);
+		m_numFreeGlyphInstances -= count;
+		return offset;
+	}
+	auto offset = m_numGlyphInstances;
+	ReserveGlyphInstances(offset +count);
+	m_numGlyphInstances += count;
+	return offset;
+}
+
+void WIText::FreeGlyphRange(uint32_t offset,uint32_t count)
+{
+	if(count == 0)
 		return;
+	// Empty instances are still part of the draw call, but won't produce any fragments
+	std::fill_n(m_glyphInstances.begin() +offset,count,GlyphInstance{});
+	MarkGlyphRangeDirty(offset,count);
+	m_numFreeGlyphInstances += count;
+
+	// Free ranges are sorted by their offset and merged with their neighbors, so they don't fragment over time
+	auto it = std::lower_bound(m_freeGlyphRanges.begin(),m_freeGlyphRanges.end(),offset,[](const std::pair<uint32_t,uint32_t> &range,uint32_t offset) {
+		return range.first < offset;
+	});
+	if(it != m_freeGlyphRanges.begin() && (it -1)->first +(it -1)->second == offset)
+	{
+		--it;
+		it->second += count;
+		auto itNext = it +1;
+		if(itNext != m_freeGlyphRanges.end() && it->first +it->second == itNext->first)
+		{
+			it->second += itNext->second;
+			it = m_freeGlyphRanges.erase(itNext) -1;
+		}
+	}
+	else if(it != m_freeGlyphRanges.end() && offset +count == it->first)
+	{
+		it->first = offset;
+		it->second += count;
+	}
+	else
+		it = m_freeGlyphRanges.insert(it,{offset,count});
+
+	// A range at the end is returned by lowering the number of used instances
+	if(it->first +it->second == m_numGlyphInstances)
+	{
+		m_numGlyphInstances = it->first;
+		m_numFreeGlyphInstances -= it->second;
+		m_freeGlyphRanges.erase(it);
 	}
+}
+
+void WIText::ReserveGlyphInstances(uint32_t count)
+{
+	if(count <= m_glyphInstances.size())
+		return;
+	auto newSize = std::max<uint32_t>({count,static_cast<uint32_t>(m_glyphInstances.size() *2),MIN_GLYPH_BUFFER_INSTANCE_COUNT});
+	m_glyphInstances.resize(newSize,GlyphInstance{});
 	auto &context = WGUI::GetInstance().GetContext();
-	//auto fontHeight = m_font->GetMaxGlyphTop();//m_font->GetMaxGlyphSize()
+	InitializeTextBuffer(context);
+	if(m_glyphBuffer != nullptr)
+		context.KeepResourceAliveUntilPresentationComplete(m_glyphBuffer);
+	m_glyphBuffer = s_textBuffer->AllocateBuffer(newSize *sizeof(GlyphInstance),sizeof(Vector4),nullptr);
+
+	m_glyphBlockOrigins.resize(newSize /GLYPH_RANGE_ALIGNMENT,0u);
+	if(m_glyphBlockOriginBuffer != nullptr)
+		context.KeepResourceAliveUntilPresentationComplete(m_glyphBlockOriginBuffer);
+	m_glyphBlockOriginBuffer = s_glyphBlockOriginBuffer->AllocateBuffer(m_glyphBlockOrigins.size() *sizeof(m_glyphBlockOrigins.front()),sizeof(uint32_t),nullptr);
+
+	// The new buffers have to be filled with all existing instances
+	m_dirtyGlyphRanges.clear();
+	MarkGlyphRangeDirty(0,m_numGlyphInstances);
+	m_dirtyGlyphBlockRange = {0u,static_cast<uint32_t>(m_glyphBlockOrigins.size())};
+}
 
-	// Initialize Buffers
-	struct SubStringInfo
-	{
-		std::string_view subString;
-		size_t hash;
-		uint32_t width;
-		uint32_t height;
-		float sx;
-		float sy;
-		util::text::CharOffset charOffset;
-		std::vector<Vector4> glyphBounds;
-		std::vector<uint32_t> glyphIndices;
-		util::text::LineIndex absLineIndex;
-	};
+void WIText::CompactGlyphInstances()
+{
+	// The range of the recycled line info isn't relocated and would overlap the compacted lines.
+	// Its glyphs are already hidden, and the free ranges are discarded as well, so it can simply be dropped.
+	m_recycledLineInfo = {};
+	std::vector<GlyphInstance> glyphInstances(m_glyphInstances.size(),GlyphInstance{});
+	uint32_t offset = 0u;
+	for(auto &lineInfo : m_lineInfos)
+	{
+		if(lineInfo.glyphCapacity == 0)
+			continue;
+		std::copy_n(m_glyphInstances.begin() +lineInfo.glyphOffset,lineInfo.glyphCapacity,glyphInstances.begin() +offset);
+		lineInfo.glyphOffset = offset;
+		offset += lineInfo.glyphCapacity;
+		SetGlyphBlockOrigin(lineInfo,lineInfo.glyphSubLineIndexOffset);
+	}
+	m_glyphInstances = std::move(glyphInstances);
+	m_numGlyphInstances = offset;
+	m_numFreeGlyphInstances = 0u;
+	m_freeGlyphRanges.clear();
+	m_dirtyGlyphRanges.clear();
+	MarkGlyphRangeDirty(0,m_numGlyphInstances);
+}
 
-	std::vector<SubStringInfo> subStrings {};
-	auto numChars = m_text->GetCharCount();
+void WIText::MarkGlyphRangeDirty(uint32_t offset,uint32_t count)
+{
+	if(count == 0)
+		return;
+	m_dirtyGlyphRanges.push_back({offset,count});
+}
 
-	const auto fAddSubString = [this,&subStrings](const std::string_view &substr,util::text::LineIndex lineIndex,util::text::CharOffset charOffset,uint32_t &inOutX,uint32_t &inOutY) {
-		if(substr.empty())
-			return;
-		if(subStrings.size() == subStrings.capacity())
-			subStrings.reserve(subStrings.size() +20);
-		subStrings.push_back({});
-		auto &info = subStrings.back();
-		info.subString = substr;
-		info.charOffset = charOffset;
-		info.hash = std::hash<std::string_view>{}(info.subString);
-		info.absLineIndex = lineIndex;
-
-		int w,h;
-		GetTextSize(&w,&h,&info.subString);
-		if(w <= 0)
-			w = 1;
-		if(h <= 0)
-			h = 1;
-		info.width = w;
-		info.height = h;
-		auto sx = info.sx = 2.f /float(w);
-		auto sy = info.sy = 2.f /float(h);
-
-		info.glyphBounds.reserve(substr.length());
-		info.glyphIndices.reserve(substr.length());
-
-		// Populate glyph bounds and indices
-		auto fontSize = m_font->GetSize();
-		auto offset = 0u;
-		auto isHidden = IsTextHidden();
-		for(auto c : info.subString)
+void WIText::SetGlyphBlockOrigin(LineInfo &lineInfo,util::text::LineIndex origin)
+{
+	lineInfo.glyphSubLineIndexOffset = origin;
+	if(lineInfo.glyphCapacity == 0)
+		return;
+	auto firstBlock = lineInfo.glyphOffset /GLYPH_RANGE_ALIGNMENT;
+	auto endBlock = (lineInfo.glyphOffset +lineInfo.glyphCapacity) /GLYPH_RANGE_ALIGNMENT;
+	std::fill(m_glyphBlockOrigins.begin() +firstBlock,m_glyphBlockOrigins.begin() +endBlock,origin);
+	auto &range = m_dirtyGlyphBlockRange;
+	if(range.second > range.first)
+		range = {umath::min(range.first,firstBlock),umath::max(range.second,endBlock)};
+	else
+		range = {firstBlock,endBlock};
+}
+
+void WIText::SetGlyphColors(const LineInfo &lineInfo,util::text::CharOffset startOffset,util::text::CharOffset endOffset,const Vector4 &color)
+{
+	if(lineInfo.glyphCapacity == 0 || startOffset >= lineInfo.glyphCapacity || endOffset < startOffset)
+		return;
+	umath::set_flag(m_flags,Flags::HasGlyphColors);
+	endOffset = std::min<util::text::CharOffset>(endOffset,lineInfo.glyphCapacity -1);
+	auto count = endOffset -startOffset +1;
+	auto packedColor = wgui::ShaderTextRect::PackColor(color);
+	auto itStart = m_glyphInstances.begin() +lineInfo.glyphOffset +startOffset;
+	for(auto it=itStart;it!=itStart +count;++it)
+	{
+		it->color = packedColor;
+		it->flags |= GlyphInstance::Flags::HasColor;
+	}
+	MarkGlyphRangeDirty(lineInfo.glyphOffset +startOffset,count);
+}
+
+void WIText::ApplyColorSpans(const LineInfo &lineInfo,GlyphInstance *instances,uint32_t numInstances) const
+{
+	for(auto &span : lineInfo.colorSpans)
+	{
+		if(span.offset >= numInstances)
+			break;
+		auto *itEnd = instances +umath::min<uint32_t>(span.offset +span.length,numInstances);
+		for(auto *it=instances +span.offset;it!=itEnd;++it)
 		{
-			if(isHidden)
-				c = '*';
-			auto multiplier = 1u;
-			if(c == '\t')
-			{
-				auto tabSpaceCount = FontManager::TAB_WIDTH_SPACE_COUNT -(offset %FontManager::TAB_WIDTH_SPACE_COUNT);
-				multiplier = tabSpaceCount;
-				c = ' ';
-			}
-			auto *glyph = m_font->GetGlyphInfo(c);
-			if(glyph == nullptr)
-				continue;
-			int32_t left,top,width,height;
-			glyph->GetDimensions(left,top,width,height);
-			width *= multiplier;
-			int32_t advanceX,advanceY;
-			glyph->GetAdvance(advanceX,advanceY);
-
-			auto x2 = (inOutX +left) *sx -1.f;
-			auto y2 = (inOutY -(top -static_cast<int>(fontSize))) *sy -1.f;
-			auto w = width *sx;
-			auto h = height *sy;
-
-			info.glyphBounds.push_back({x2,y2,width,height});
-			info.glyphIndices.push_back(FontInfo::CharToGlyphMapIndex(c));
-
-			advanceX >>= 6;
-			advanceX *= multiplier;
-			advanceY >>= 6;
-			inOutX += advanceX;
-			inOutY += advanceY;
-			offset += multiplier;
+			it->color = span.color;
+			it->flags |= GlyphInstance::Flags::HasColor;
 		}
-	};
-	auto y = 0u; // lineIndex *GetLineHeight();
-	auto x = 0u;
-	auto pLine = lineInfo.wpLine.lock();
-	auto lineView = std::string_view{pLine->GetFormattedLine()};
-	auto subString = lineView;
-	util::text::CharOffset offset = 0;
-	auto subLines = lineInfo.subLines;
-	while(subString.empty() == false)
-	{
-		auto curLineIndex = lineIndex;
-		auto numChars = std::min<uint32_t>(MAX_CHARS_PER_BUFFER,subString.length());
-		auto newLine = false;
-		if(subLines.empty() == false)
+	}
+}
+
+void WIText::SetLineColorSpans(util::text::LineIndex lineIdx,const std::vector<ColorSpan> &spans) {SetLineColorSpans(lineIdx,spans.data(),spans.size());}
+void WIText::SetLineColorSpans(util::text::LineIndex lineIdx,const ColorSpan *spans,uint32_t numSpans)
+{
+	if(lineIdx >= m_lineInfos.size())
+		return;
+	auto &lineInfo = m_lineInfos.at(lineIdx);
+	if(lineInfo.colorSpans.empty() && numSpans == 0)
+		return;
+	auto updateInstances = (lineInfo.bufferUpdateRequired == false && lineInfo.glyphCapacity > 0);
+	auto *instances = updateInstances ? (m_glyphInstances.data() +lineInfo.glyphOffset) : nullptr;
+	// Range of instances that have changed [first,last)
+	auto first = std::numeric_limits<uint32_t>::max();
+	uint32_t last = 0u;
+	if(updateInstances)
+	{
+		// Reset the glyphs of the previous spans to the element color
+		for(auto &span : lineInfo.colorSpans)
 		{
-			auto &numCharsSubLine = subLines.front();
-			numChars = std::min<uint32_t>(numCharsSubLine,numChars);
-			numCharsSubLine -= numChars;
-			if(numCharsSubLine == 0)
+			if(span.offset >= lineInfo.glyphCapacity)
+				break;
+			auto end = umath::min<uint32_t>(span.offset +span.length,lineInfo.glyphCapacity);
+			for(auto i=span.offset;i<end;++i)
 			{
-				newLine = true;
-				subLines.erase(subLines.begin());
-				++lineIndex;
+				auto &instance = instances[i];
+				instance.color = 0u;
+				instance.flags &= ~GlyphInstance::Flags::HasColor;
 			}
+			first = umath::min<uint32_t>(first,span.offset);
+			last = umath::max(last,end);
 		}
-		fAddSubString(subString.substr(0ull,numChars),curLineIndex,offset,x,y);
-		subString = subString.substr(numChars);
-		offset += numChars;
-		if(newLine)
-			x = 0;
 	}
-
-	lineInfo.buffers.clear();
-	auto bufferOffset = 0u;
-	for(auto &subStrInfo : subStrings)
+	lineInfo.colorSpans.assign(spans,spans +numSpans);
+	std::stable_sort(lineInfo.colorSpans.begin(),lineInfo.colorSpans.end(),[](const ColorSpan &a,const ColorSpan &b) {return a.offset < b.offset;});
+	if(updateInstances == false)
+		return; // Spans will be applied when the glyph instances of the line are initialized
+	ApplyColorSpans(lineInfo,instances,lineInfo.glyphCapacity);
+	for(auto &span : lineInfo.colorSpans)
 	{
-		ScopeGuard sg{[this,&subStrInfo,&bufferOffset]() {
-			++bufferOffset;
-		}};
+		if(span.offset >= lineInfo.glyphCapacity)
+			break;
+		first = umath::min<uint32_t>(first,span.offset);
+		last = umath::max<uint32_t>(last,umath::min<uint32_t>(span.offset +span.length,lineInfo.glyphCapacity));
+	}
+	if(last > first)
+		MarkGlyphRangeDirty(lineInfo.glyphOffset +first,last -first);
+	if(umath::is_flag_set(m_flags,Flags::HasGlyphColors))
+		MarkLineTagsDirty(lineIdx); // Color tags have to be re-applied on top of the spans
+	ScheduleRenderUpdate();
+}
+void WIText::ClearColorSpans()
+{
+	for(auto lineIdx=decltype(m_lineInfos.size()){0u};lineIdx<m_lineInfos.size();++lineIdx)
+		SetLineColorSpans(lineIdx,nullptr,0);
+}
 
-		auto bExistingBuffer = bufferOffset < lineInfo.buffers.size();
-		if(bExistingBuffer == true)
-		{
-			/*auto &curBufInfo = lineInfo.buffers.at(bufferOffset);
-			if(
-				curBufInfo.subStringHash == subStrInfo.hash &&
-				curBufInfo.width == subStrInfo.width && curBufInfo.height == subStrInfo.height &&
-				curBufInfo.sx == subStrInfo.sx && curBufInfo.sy == subStrInfo.sy &&
-				curBufInfo.range == subStrInfo.range
-			)
-				continue; // No need to update the buffer
-				*/
-		}
-		std::vector<GlyphBoundsInfo> glyphBoundsData {};
-		glyphBoundsData.reserve(subStrInfo.glyphBounds.size());
-		for(auto i=decltype(subStrInfo.glyphBounds.size()){0u};i<subStrInfo.glyphBounds.size();++i)
+void WIText::UploadGlyphInstances()
+{
+	if(m_numFreeGlyphInstances >= MIN_GLYPH_BUFFER_INSTANCE_COUNT && m_numFreeGlyphInstances > m_numGlyphInstances /2)
+		CompactGlyphInstances();
+	auto &uploadManager = WGUI::GetInstance().GetUploadManager();
+	auto &blockRange = m_dirtyGlyphBlockRange;
+	if(blockRange.second > blockRange.first && m_glyphBlockOriginBuffer != nullptr)
+	{
+		uploadManager.ScheduleUpdate(
+			m_glyphBlockOriginBuffer,
+			blockRange.first *sizeof(uint32_t),(blockRange.second -blockRange.first) *sizeof(uint32_t),m_glyphBlockOrigins.data() +blockRange.first
+		);
+	}
+	blockRange = {0u,0u};
+	if(m_dirtyGlyphRanges.empty() || m_glyphBuffer == nullptr)
+		return;
+	// Merge overlapping and adjacent ranges to keep the number of copies low
+	std::sort(m_dirtyGlyphRanges.begin(),m_dirtyGlyphRanges.end());
+	std::vector<std::pair<uint32_t,uint32_t>> ranges {};
+	ranges.reserve(m_dirtyGlyphRanges.size());
+	for(auto &range : m_dirtyGlyphRanges)
+	{
+		if(ranges.empty() == false && range.first <= ranges.back().first +ranges.back().second)
 		{
-			auto &bounds = subStrInfo.glyphBounds.at(i);
-			auto index = subStrInfo.glyphIndices.at(i);
-			glyphBoundsData.push_back({static_cast<int32_t>(index),bounds});
+			auto &prevRange = ranges.back();
+			prevRange.second = std::max(prevRange.second,range.first +range.second -prevRange.first);
+			continue;
 		}
-		if(bExistingBuffer == false)
-			lineInfo.buffers.push_back({s_textBuffer->AllocateBuffer()});
-		// Update existing buffer
-		auto &bufInfo = lineInfo.buffers.at(bufferOffset);
-		// bufInfo.subStringHash = subStrInfo.hash;
-		bufInfo.numChars = subStrInfo.subString.length();
-		bufInfo.charOffset = subStrInfo.charOffset;
-		bufInfo.absLineIndex = subStrInfo.absLineIndex;
-		bufInfo.colorBuffer = nullptr;
-
-		bufInfo.width = subStrInfo.width;
-		bufInfo.height = subStrInfo.height;
-		bufInfo.sx = subStrInfo.sx;
-		bufInfo.sy = subStrInfo.sy;
-		context.ScheduleRecordUpdateBuffer(
-			bufInfo.buffer,
-			0ull,glyphBoundsData.size() *sizeof(glyphBoundsData.front()),glyphBoundsData.data()
-		);
+		ranges.push_back(range);
+	}
+	m_dirtyGlyphRanges.clear();
 
-		context.GetDrawCommandBuffer()->RecordBufferBarrier(
-			*bufInfo.buffer,
-			prosper::PipelineStageFlags::TransferBit,prosper::PipelineStageFlags::VertexInputBit,prosper::AccessFlags::TransferWriteBit,prosper::AccessFlags::VertexAttributeReadBit
+	// The actual transfer (and barrier) is recorded together with the updates of all other elements, see WGUI::Think
+	for(auto &range : ranges)
+	{
+		auto offset = range.first;
+		auto count = std::min<uint32_t>(range.second,m_numGlyphInstances -std::min(offset,m_numGlyphInstances));
+		if(count == 0)
+			continue;
+		uploadManager.ScheduleUpdate(
+			m_glyphBuffer,
+			offset *sizeof(GlyphInstance),count *sizeof(GlyphInstance),m_glyphInstances.data() +offset
 		);
 	}
-	lineInfo.buffers.resize(bufferOffset);
 }
 
 void WIText::RemoveDecorator(const WITextDecorator &decorator)
@@ -624,6 +991,7 @@ void WIText::RemoveDecorator(const WITextDecorator &decorator)
 	});
 	if(it == m_tagInfos.end())
 		return;
+	OnDecoratorRemoved(**it);
 	m_tagInfos.erase(it);
 }
 
@@ -631,155 +999,212 @@ void WIText::InitializeTextBuffer(prosper::IPrContext &context)
 {
 	if(s_textBuffer != nullptr)
 		return;
-	const auto maxInstances = 8'192; // 5 MiB total space
-	auto instanceSize = sizeof(GlyphBoundsInfo) *MAX_CHARS_PER_BUFFER;
 	prosper::util::BufferCreateInfo createInfo {};
 	createInfo.usageFlags = prosper::BufferUsageFlags::VertexBufferBit | prosper::BufferUsageFlags::TransferDstBit;
 	createInfo.memoryFeatures = prosper::MemoryFeatureFlags::DeviceLocal;
-	createInfo.size = instanceSize *maxInstances;
-	s_textBuffer = context.CreateUniformResizableBuffer(createInfo,instanceSize,createInfo.size *5u,0.05f);
-	s_textBuffer->SetPermanentlyMapped(true);
-	s_textBuffer->SetDebugName("text_glyph_bounds_info_buf");
+	createInfo.size = sizeof(GlyphInstance) *TEXT_BUFFER_INSTANCE_COUNT; // 4 MiB
+	s_textBuffer = context.CreateDynamicResizableBuffer(createInfo,createInfo.size *5u,0.05f);
+	s_textBuffer->SetDebugName("text_glyph_instance_buf");
+
+	// One block origin per GLYPH_RANGE_ALIGNMENT glyph instances. The buffer is created at its maximum size, since the
+	// descriptor set would have to be updated if the buffer was re-allocated.
+	createInfo.usageFlags = prosper::BufferUsageFlags::StorageBufferBit | prosper::BufferUsageFlags::TransferDstBit;
+	createInfo.size = ((createInfo.size *5u) /sizeof(GlyphInstance) /GLYPH_RANGE_ALIGNMENT) *sizeof(uint32_t);
+	s_glyphBlockOriginBuffer = context.CreateDynamicResizableBuffer(createInfo,createInfo.size,0.05f);
+	s_glyphBlockOriginBuffer->SetDebugName("text_glyph_block_origin_buf");
+	s_glyphBlockOriginDsg = context.CreateDescriptorSetGroup(wgui::ShaderTextRect::DESCRIPTOR_SET_GLYPH_BLOCK_ORIGIN_BUFFER);
+	s_glyphBlockOriginDsg->GetDescriptorSet()->SetBindingStorageBuffer(*s_glyphBlockOriginBuffer,0u);
 }
 void WIText::ClearTextBuffer()
 {
 	s_textBuffer = nullptr;
-	WITextTagColor::ClearColorBuffer();
+	s_glyphBlockOriginBuffer = nullptr;
+	s_glyphBlockOriginDsg = nullptr;
+	s_cacheAtlas = nullptr;
+	s_blurCompositor = nullptr;
 }
-void WITextBase::SetTextElement(WIText &elText)
+void WIText::FlushBlurredShadows()
 {
-	m_hText = elText.GetHandle();
+	if(s_blurCompositor != nullptr)
+		s_blurCompositor->Flush();
 }
-void WITextBase::InitializeTexture(prosper::Texture &tex,int32_t w,int32_t h)
+void WIText::InitializeCacheRect(prosper::Texture &tex,int32_t w,int32_t h,const Vector4 &uvRect)
 {
-	if(m_hTexture.IsValid())
+	// The cached text is displayed by a child element, which is only created once the cache is actually used
+	if(m_cacheRect.IsValid() == false)
 	{
-		static_cast<WITexturedRect*>(m_hTexture.get())->SetTexture(tex);
-		return;
+		auto *pEl = WGUI::GetInstance().Create<WITexturedRect>(this);
+		pEl->SetAlphaOnly(true);
+		pEl->SetZPos(1);
+		pEl->SetAlpha(0.f);
+		pEl->GetColorProperty()->Link(*GetColorProperty());
+		pEl->SetAutoAlignToParent(true);
+		pEl->SetSize(w,h);
+		m_cacheRect = pEl->GetHandle();
 	}
-	auto *pEl = WGUI::GetInstance().Create<WITexturedRect>(this);
-	pEl->SetAlphaOnly(true);
-	pEl->SetZPos(1);
-	pEl->SetAlpha(0.f);
-	pEl->GetColorProperty()->Link(*GetColorProperty());
-	pEl->SetAutoAlignToParent(true);
-	pEl->SetSize(w,h);
-	m_hTexture = pEl->GetHandle();
+	auto *pEl = static_cast<WITexturedRect*>(m_cacheRect.get());
+	pEl->SetTexture(tex);
+	set_uv_rect(*pEl,uvRect);
 }
 
-bool WITextBase::RenderLines(
-	wgui::ShaderTextRect &shader,int32_t width,int32_t height,
+void WIText::RenderLines(
+	int32_t width,int32_t height,
 	const Vector2i &absPos,const Mat4 &transform,const Vector2i &origin,
 	const Mat4 &matParent,Vector2i &inOutSize,
-	wgui::ShaderTextRect::PushConstants &inOutPushConstants,
-	const std::function<void(const SubBufferInfo&,prosper::IDescriptorSet&)> &fDraw,
-	bool colorPass
-) const
+	wgui::ShaderTextRect::PushConstants &inOutPushConstants
+)
 {
-	auto &textEl = static_cast<WIText&>(*m_hText.get());
-	auto &context = WGUI::GetInstance().GetContext();
-	auto &drawCmd = context.GetDrawCommandBuffer();
-	if(shader.BeginDraw(drawCmd,width,height) == false)
-		return false;
+	if(m_glyphBuffer == nullptr || m_glyphBlockOriginBuffer == nullptr || m_numGlyphInstances == 0)
+		return;
+	auto matText = GetTransformedMatrix(origin,width,height,matParent);
+	auto h = GetHeight();
+	if(m_subLineOrigin > 0 && h > 0)
+	{
+		// Glyph positions are relative to the sub-line origin of the text (see m_subLineOrigin)
+		auto yOffset = static_cast<float>(m_subLineOrigin) *static_cast<float>(GetLineHeight());
+		matText = glm::translate(matText,Vector3{0.f,-2.f *yOffset /static_cast<float>(h),0.f});
+	}
+	auto &gui = WGUI::GetInstance();
+	auto hasEffects = (inOutPushConstants.shadowColor >> 24u) != 0u || inOutPushConstants.outlineWidth > 0.f;
+
+	// Only the glyphs within the scissor rectangle are drawn, so the cost doesn't depend on the size of the text
 	uint32_t xScissor,yScissor,wScissor,hScissor;
-	WGUI::GetInstance().GetScissor(xScissor,yScissor,wScissor,hScissor);
+	gui.GetScissor(xScissor,yScissor,wScissor,hScissor);
+	auto margin = static_cast<int32_t>(m_font->GetMaxGlyphSize());
+	if(hasEffects)
+		margin += umath::max(std::abs(m_shadow.offset.x),std::abs(m_shadow.offset.y)) +static_cast<int32_t>(std::ceil(m_outline.width));
+	auto &glyphRanges = m_visibleGlyphRanges;
+	CollectVisibleGlyphRanges(
+		static_cast<int32_t>(xScissor) -absPos.x,static_cast<int32_t>(yScissor) -absPos.y,
+		static_cast<int32_t>(xScissor +wScissor) -absPos.x,static_cast<int32_t>(yScissor +hScissor) -absPos.y,
+		margin,glyphRanges
+	);
+	if(glyphRanges.empty())
+		return;
 
-	auto bHasColorBuffers = false;
-	auto *descSet = textEl.m_font->GetGlyphMapDescriptorSet();
-	auto lineHeight = textEl.GetLineHeight();
-	uint32_t lineIndex = 0;
-	for(auto &lineInfo : textEl.m_lineInfos)
+	auto *batcher = gui.GetTextBatcher();
+	if(batcher != nullptr && hasEffects == false && gui.GetTextBatchShader() != nullptr)
 	{
-		if(lineInfo.buffers.empty())
-			continue;
-		auto &firstBufferInfo = lineInfo.buffers.front();
-		auto firstLineIndex = firstBufferInfo.absLineIndex;
-
-		auto &lastBufferInfo = lineInfo.buffers.back();
-		auto lastLineIndex = lastBufferInfo.absLineIndex;
+		// Glyphs will be rendered together with the glyphs of other text elements
+		inOutSize = {2,2};
+		batcher->Add(
+			m_font,GetLineHeight(),width,height,matText,inOutPushConstants.elementData.color,
+			m_glyphInstances.data(),m_glyphBlockOrigins.data(),glyphRanges
+		);
+		return;
+	}
+	auto *pShader = WGUI::GetInstance().GetTextRectShader();
+	if(pShader == nullptr)
+		return;
+	auto &context = WGUI::GetInstance().GetContext();
+	auto &drawCmd = context.GetDrawCommandBuffer();
+	if(pShader->BeginDraw(drawCmd,width,height) == false)
+		return;
+	// Glyph bounds are stored in pixels relative to the element, which is equivalent
+	// to rendering into a 2x2 box with a scale of 1.
+	inOutPushConstants.fontInfo.widthScale = 1.f;
+	inOutPushConstants.fontInfo.heightScale = 1.f;
+	inOutPushConstants.fontInfo.lineMetrics = wgui::ShaderText::PackLineMetrics(GetLineHeight(),m_font->GetSize());
+	inOutSize = {2,2};
+	inOutPushConstants.elementData.modelMatrix = matText;
+	inOutPushConstants.glyphBlockOriginOffset = static_cast<uint32_t>(m_glyphBlockOriginBuffer->GetStartOffset() /sizeof(uint32_t));
+
+	auto *descSet = m_font->GetGlyphMapDescriptorSet();
+	pShader->Draw(
+		*m_glyphBuffer,*descSet,*m_font->GetGlyphBoundsDescriptorSet(),*s_glyphBlockOriginDsg->GetDescriptorSet(),
+		inOutPushConstants,glyphRanges
+	);
+	pShader->EndDraw();
+}
 
-		int32_t yLineStartPxOffset = absPos.y +static_cast<int32_t>(firstLineIndex) *lineHeight;
-		int32_t yLineEndPxOffset = absPos.y +(static_cast<int32_t>(lastLineIndex) +1) *lineHeight;
+void WIText::RenderDecorations(const DrawInfo &drawInfo,const Mat4 &matDraw,WITextDecorator::Quad::Layer layer)
+{
+	auto &size = GetSize();
+	auto numSubLines = GetTotalLineCount();
+	if(m_tagInfos.empty() || numSubLines == 0 || size.x <= 0 || size.y <= 0 || GetFont() == nullptr)
+		return;
+	auto lineHeight = GetLineHeight();
+	if(lineHeight <= 0)
+		return;
+	auto *pShader = WGUI::GetInstance().GetColoredRectShader();
+	if(pShader == nullptr)
+		return;
+	auto col = drawInfo.GetColor(*this);
+	if(col.a <= 0.f)
+		return;
 
-		if(yLineEndPxOffset < static_cast<int32_t>(yScissor))
-			continue; // Line is out of scissor bounds; We don't need to render it
-		if(yLineStartPxOffset >= static_cast<int32_t>(yScissor +hScissor))
-			break; // Line is out of scissor bounds; We can skip all remaining lines altogether
+	// Only the decorators of the lines within the scissor rect have to be rendered. The quads of a decorator are sorted by
+	// their vertical position and never exceed the height of a line (plus the underline offset).
+	Vector2i absPos,absSize;
+	CalcBounds(matDraw,drawInfo.size.x,drawInfo.size.y,absPos,absSize);
+	uint32_t xScissor,yScissor,wScissor,hScissor;
+	WGUI::GetInstance().GetScissor(xScissor,yScissor,wScissor,hScissor);
+	auto yStart = static_cast<int32_t>(yScissor) -absPos.y -lineHeight -2;
+	auto yEnd = static_cast<int32_t>(yScissor +hScissor) -absPos.y;
+	if(yEnd <= 0)
+		return;
+	auto startSubLineIdx = umath::min(static_cast<util::text::LineIndex>(umath::max(yStart,0) /lineHeight),numSubLines -1);
+	auto endSubLineIdx = umath::min(static_cast<util::text::LineIndex>(yEnd /lineHeight),numSubLines -1);
 
-		for(auto &bufInfo : lineInfo.buffers)
+	// Quads are positioned relative to the sub-line origin (see WITextDecorator::Quad::pos)
+	auto yOrigin = static_cast<int32_t>(m_subLineOrigin *lineHeight);
+	auto &context = WGUI::GetInstance().GetContext();
+	auto drawCmd = context.GetDrawCommandBuffer();
+	auto drawing = false;
+	IterateDecorators(GetLineIndexFromSubLineIndex(startSubLineIdx),GetLineIndexFromSubLineIndex(endSubLineIdx),[&](WITextDecorator &decorator) {
+		auto &quads = decorator.GetQuads();
+		auto it = std::lower_bound(quads.begin(),quads.end(),yStart +yOrigin,[](const WITextDecorator::Quad &quad,int32_t y) {
+			return quad.pos.y < y;
+		});
+		for(;it!=quads.end() && it->pos.y < yEnd +yOrigin;++it)
 		{
-			if(bufInfo.colorBuffer != nullptr)
+			auto &quad = *it;
+			if(quad.layer != layer || quad.size.x <= 0 || quad.size.y <= 0)
+				continue;
+			if(drawing == false)
 			{
-				bHasColorBuffers = true;
-				if(colorPass == false)
-					continue;
+				if(pShader->BeginDraw(drawCmd,drawInfo.size.x,drawInfo.size.y) == false)
+					return false;
+				drawing = true;
 			}
-			else if(colorPass)
-				continue;
-			inOutPushConstants.fontInfo.widthScale = bufInfo.sx;
-			inOutPushConstants.fontInfo.heightScale = bufInfo.sy;
-
-			inOutSize.x = bufInfo.width;
-			inOutSize.y = bufInfo.height;
-
-			// Temporarily change size to that of the text (instead of the element) to make sure GetTransformedMatrix returns the right matrix.
-			// This will be reset further below.
-			auto matText = GetTransformedMatrix(origin,width,height,matParent);
-			inOutPushConstants.elementData.modelMatrix = matText;
-
-			inOutPushConstants.fontInfo.yOffset = bufInfo.absLineIndex *lineHeight;
-
-			fDraw(bufInfo,*descSet);
+			// The element matrix transforms the unit square to the bounds of the element; The quad is a sub-rect of it
+			auto matQuad = glm::translate(matDraw,Vector3{
+				-1.f +(2.f *quad.pos.x +quad.size.x) /static_cast<float>(size.x),
+				-1.f +(2.f *(quad.pos.y -yOrigin) +quad.size.y) /static_cast<float>(size.y),
+				0.f
+			});
+			matQuad = glm::scale(matQuad,Vector3{quad.size.x /static_cast<float>(size.x),quad.size.y /static_cast<float>(size.y),1.f});
+			auto color = quad.color;
+			color.a *= col.a;
+			pShader->Draw({matQuad,color});
 		}
-	}
-	shader.EndDraw();
-	return bHasColorBuffers;
-}
-
-void WITextBase::RenderLines(
-	int32_t width,int32_t height,
-	const Vector2i &absPos,const Mat4 &transform,const Vector2i &origin,
-	const Mat4 &matParent,Vector2i &inOutSize,
-	wgui::ShaderTextRect::PushConstants &inOutPushConstants
-) const
-{
-	auto *pShaderTextRect = WGUI::GetInstance().GetTextRectShader();
-	auto bHasColorBuffers = RenderLines(*pShaderTextRect,width,height,absPos,transform,origin,matParent,inOutSize,inOutPushConstants,[&inOutPushConstants,pShaderTextRect](const SubBufferInfo &bufInfo,prosper::IDescriptorSet &descSet) {
-		pShaderTextRect->Draw(*bufInfo.buffer,descSet,inOutPushConstants,bufInfo.numChars);
-	},false);
-	if(bHasColorBuffers == false)
-		return;
-	auto *pShaderTextRectColor = WGUI::GetInstance().GetTextRectColorShader();
-	RenderLines(*pShaderTextRectColor,width,height,absPos,transform,origin,matParent,inOutSize,inOutPushConstants,[&inOutPushConstants,pShaderTextRectColor](const SubBufferInfo &bufInfo,prosper::IDescriptorSet &descSet) {
-		pShaderTextRectColor->Draw(*bufInfo.buffer,*bufInfo.colorBuffer,descSet,inOutPushConstants,bufInfo.numChars);
-	},true);
+		return true;
+	});
+	if(drawing)
+		pShader->EndDraw();
 }
 
-void WITextBase::Render(const DrawInfo &drawInfo,const Mat4 &matDraw)
+void WIText::Render(const DrawInfo &drawInfo,const Mat4 &matDraw)
 {
 	WIBase::Render(drawInfo,matDraw);
-	if(m_hText.IsValid() == false)
-		return;
-	auto &textEl = static_cast<WIText&>(*m_hText.get());
-	if(textEl.m_renderTarget != nullptr && textEl.IsCacheEnabled() == true)
+	// Decorations are rendered as plain quads behind (e.g. selections) or in front of (e.g. underlines) the glyphs
+	RenderDecorations(drawInfo,matDraw,WITextDecorator::Quad::Layer::Background);
+	if(m_renderTarget != nullptr && IsCacheEnabled() == true)
+	{
+		RenderDecorations(drawInfo,matDraw,WITextDecorator::Quad::Layer::Foreground);
 		return;
+	}
 	auto *pShaderTextRect = WGUI::GetInstance().GetTextRectShader();
-	auto *pShaderTextRectColor = WGUI::GetInstance().GetTextRectColorShader();
 	if(pShaderTextRect != nullptr)
 	{
-		auto *pFont = textEl.GetFont();
+		auto *pFont = GetFont();
 		if(pFont == nullptr)
 			return;
 		auto &context = WGUI::GetInstance().GetContext();
-		for(auto &lineInfo : textEl.m_lineInfos)
-		{
-			for(auto &bufInfo : lineInfo.buffers)
-			{
-				context.KeepResourceAliveUntilPresentationComplete(bufInfo.buffer);
-				if(bufInfo.colorBuffer)
-					context.KeepResourceAliveUntilPresentationComplete(bufInfo.colorBuffer);
-			}
-		}
+		if(m_glyphBuffer != nullptr)
+			context.KeepResourceAliveUntilPresentationComplete(m_glyphBuffer);
+		if(m_glyphBlockOriginBuffer != nullptr)
+			context.KeepResourceAliveUntilPresentationComplete(m_glyphBlockOriginBuffer);
 
 		auto drawCmd = context.GetDrawCommandBuffer();
 		auto glyphMap = pFont->GetGlyphMap();
@@ -801,52 +1226,49 @@ void WITextBase::Render(const DrawInfo &drawInfo,const Mat4 &matDraw)
 		};
 		Vector2i absPos,absSize;
 		CalcBounds(matDraw,drawInfo.size.x,drawInfo.size.y,absPos,absSize);
-		const auto fDraw = [&context,&drawCmd,&pushConstants,&size,&drawInfo,&matDraw,pFont,this,&textEl,&absPos,&absSize](bool bClear) {
-			RenderLines(drawInfo.size.x,drawInfo.size.y,absPos,matDraw,drawInfo.offset,drawInfo.transform /* parent transform */,size,pushConstants);
-		};
-
-		// Render Shadow
-		if(textEl.m_shadow.enabled)
+		auto lineHeight = GetLineHeight();
+		if(IsVirtualized() && lineHeight > 0)
+		{
+			// Usually already covered by UpdateVisibleSubLineRange, but the element may have been transformed
+			uint32_t xScissor,yScissor,wScissor,hScissor;
+			WGUI::GetInstance().GetScissor(xScissor,yScissor,wScissor,hScissor);
+			auto yStart = umath::max(static_cast<int32_t>(yScissor) -absPos.y,0);
+			auto yEnd = umath::max(static_cast<int32_t>(yScissor +hScissor) -absPos.y,0);
+			SetVisibleSubLineRange(yStart /lineHeight,yEnd /lineHeight +1);
+		}
+		if(pShaderTextRect->AreSinglePassEffectsSupported())
 		{
-			auto *pShadowColor = textEl.GetShadowColor();
-			if(pShadowColor != nullptr && pShadowColor->w > 0.f)
+			// Shadow and outline are rendered by the text shader in the same pass as the text itself
+			if(m_shadow.enabled && m_shadow.color.a > 0.f)
 			{
-				auto *pOffset = textEl.GetShadowOffset();
-				auto currentPos = GetPosProperty()->GetValue();
-				auto &pos = GetPosProperty()->GetValue();
-				if(pOffset != nullptr)
-				{
-					pos.x += pOffset->x;
-					pos.y += pOffset->y;
-				}
-				auto tmpMatrix = pushConstants.elementData.modelMatrix;
-				auto tmpColor = pushConstants.elementData.color;
-				pushConstants.elementData.modelMatrix = GetTransformedMatrix(drawInfo.offset,drawInfo.size.x,drawInfo.size.y,drawInfo.transform /* parent transform */);
-				if(pShadowColor != nullptr)
-					pushConstants.elementData.color = *pShadowColor;
-				fDraw(true); // TODO: Render text shadow shadow at the same time? (Single framebuffer)
-				pos = currentPos;
-				pushConstants.elementData.modelMatrix = tmpMatrix;
-				pushConstants.elementData.color = tmpColor;
-
-				/*if(m_shadow.blurSize != 0.f && m_shadowBlurSet != nullptr)
-				{
-					prosper::util::record_blur_image(context.GetDevice(),drawCmd,*m_shadowBlurSet,{
-						Vector4(2.f,1.f,1.f,1.f),
-						m_shadow.blurSize,
-						9
-					});
-				}*/
-				//prosper::util::record_set_viewport(*drawCmd,m_wTexture,m_hTexture);
+				pushConstants.shadowColor = wgui::ShaderTextRect::PackColor(m_shadow.color);
+				pushConstants.shadowOffset = wgui::ShaderTextRect::PackOffset(m_shadow.offset);
 			}
+			if(m_outline.width > 0.f && m_outline.color.a > 0.f)
+			{
+				pushConstants.outlineColor = wgui::ShaderTextRect::PackColor(m_outline.color);
+				pushConstants.outlineWidth = m_outline.width;
+			}
+		}
+		else if(m_shadow.enabled && m_shadow.color.a > 0.f)
+		{
+			// The shader doesn't support the effect push constants, so the shadow is rendered as a separate pass with
+			// the text offset and tinted in the shadow color
+			auto currentPos = GetPosProperty()->GetValue();
+			auto &pos = GetPosProperty()->GetValue();
+			pos.x += m_shadow.offset.x;
+			pos.y += m_shadow.offset.y;
+			auto color = pushConstants.elementData.color;
+			pushConstants.elementData.color = m_shadow.color;
+			RenderLines(drawInfo.size.x,drawInfo.size.y,absPos +m_shadow.offset,matDraw,drawInfo.offset,drawInfo.transform /* parent transform */,size,pushConstants);
+			pos = currentPos;
+			pushConstants.elementData.color = color;
+			size = currentSize;
 		}
-		//
-	
-		// Render Text
-		fDraw(false);
-		//
+		RenderLines(drawInfo.size.x,drawInfo.size.y,absPos,matDraw,drawInfo.offset,drawInfo.transform /* parent transform */,size,pushConstants);
 
 		// Reset size
 		size = currentSize;
 	}
+	RenderDecorations(drawInfo,matDraw,WITextDecorator::Quad::Layer::Foreground);
 }
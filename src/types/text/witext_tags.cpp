@@ -8,6 +8,7 @@
 #include "wgui/types/wirect.h"
 #include <util_formatted_text.hpp>
 #include <util_formatted_text_tag.hpp>
+#include <util_formatted_text_anchor_point.hpp>
 #include <prosper_context.hpp>
 #include <prosper_util.hpp>
 #include <buffers/prosper_uniform_resizable_buffer.hpp>
@@ -63,7 +64,151 @@ void WIText::SetTagsEnabled(bool bEnabled) {m_text->SetTagsEnabled(bEnabled);}
 bool WIText::AreTagsEnabled() const {return m_text->AreTagsEnabled();}
 
 bool WIText::IsTextHidden() const {return umath::is_flag_set(m_flags,Flags::HideText);}
-void WIText::HideText(bool hide) {umath::set_flag(m_flags,Flags::HideText,hide);}
+void WIText::HideText(bool hide)
+{
+	if(hide == IsTextHidden())
+		return;
+	umath::set_flag(m_flags,Flags::HideText,hide);
+	InvalidateLineMetrics();
+}
+
+std::vector<std::shared_ptr<WITextDecorator>>::iterator WIText::FindFirstDecoratorCoveringLine(util::text::LineIndex lineIdx)
+{
+	// Decorators are sorted by their start offset, so any decorator covering this line has to start
+	// within the preceding m_maxDecoratorLineSpan lines
+	auto firstLineIdx = (lineIdx > m_maxDecoratorLineSpan) ? (lineIdx -m_maxDecoratorLineSpan) : 0;
+	auto pFirstLine = (firstLineIdx < m_lineInfos.size()) ? m_lineInfos.at(firstLineIdx).wpLine.lock() : nullptr;
+	if(pFirstLine == nullptr)
+		return m_tagInfos.begin();
+	auto startOffset = pFirstLine->GetStartOffset();
+	return std::lower_bound(m_tagInfos.begin(),m_tagInfos.end(),startOffset,[](const std::shared_ptr<WITextDecorator> &decorator,util::text::TextOffset offset) {
+		return decorator->GetStartTextCharOffset() < offset;
+	});
+}
+
+void WIText::IterateDecorators(util::text::LineIndex startLineIdx,util::text::LineIndex endLineIdx,const std::function<bool(WITextDecorator&)> &f)
+{
+	auto pEndLine = (endLineIdx < m_lineInfos.size()) ? m_lineInfos.at(endLineIdx).wpLine.lock() : nullptr;
+	auto endOffset = (pEndLine != nullptr) ? pEndLine->GetAbsEndOffset() : std::numeric_limits<util::text::TextOffset>::max();
+	// Unclosed decorators aren't considered by FindFirstDecoratorCoveringLine, since they would have to be found from the start of the text
+	for(auto &wpDecorator : m_unclosedDecorators)
+	{
+		auto decorator = wpDecorator.lock();
+		if(decorator == nullptr || decorator->GetStartTextCharOffset() > endOffset)
+			continue;
+		if(f(*decorator) == false)
+			return;
+	}
+	for(auto it=FindFirstDecoratorCoveringLine(startLineIdx);it!=m_tagInfos.end();++it)
+	{
+		auto &decorator = **it;
+		if(decorator.GetStartTextCharOffset() > endOffset)
+			break; // Decorators are sorted by their start offset
+		if(decorator.m_lineSpan == std::numeric_limits<util::text::LineIndex>::max())
+			continue; // Unclosed decorator, see above
+		if(f(decorator) == false)
+			return;
+	}
+}
+
+void WIText::MarkLineTagsDirty(util::text::LineIndex lineIdx)
+{
+	auto &wpLine = m_lineInfos.at(lineIdx).wpLine;
+	if(wpLine.expired())
+		return;
+	auto pLine = wpLine.lock();
+	auto lineStartOffset = pLine->GetStartOffset();
+	IterateDecorators(lineIdx,lineIdx,[lineStartOffset](WITextDecorator &decorator) {
+		if(decorator.GetEndTextCharOffset() >= lineStartOffset)
+			decorator.SetDirty();
+		return true;
+	});
+}
+
+void WIText::MarkShiftedDecoratorsDirty(util::text::LineIndex firstLineIdx)
+{
+	// Quads are positioned in pixels and have to be updated if their lines have moved. Glyph colors
+	// move with their glyphs, so decorators without quads don't have to be re-applied.
+	if(firstLineIdx >= m_lineInfos.size())
+		return;
+	auto pLine = m_lineInfos.at(firstLineIdx).wpLine.lock();
+	if(pLine == nullptr)
+		return;
+	auto lineStartOffset = pLine->GetStartOffset();
+	IterateDecorators(firstLineIdx,m_lineInfos.size() -1,[lineStartOffset](WITextDecorator &decorator) {
+		if(decorator.GetQuads().empty() == false && decorator.GetEndTextCharOffset() >= lineStartOffset)
+			decorator.SetDirty();
+		return true;
+	});
+}
+
+void WIText::SetDecoratorLineSpan(WITextDecorator &decorator,std::optional<util::text::LineIndex> lineSpan)
+{
+	if(decorator.m_lineSpan == lineSpan)
+		return;
+	constexpr auto unclosedSpan = std::numeric_limits<util::text::LineIndex>::max();
+	if(decorator.m_lineSpan.has_value())
+	{
+		if(*decorator.m_lineSpan == unclosedSpan)
+		{
+			auto it = std::find_if(m_unclosedDecorators.begin(),m_unclosedDecorators.end(),[&decorator](const std::weak_ptr<WITextDecorator> &wpOther) {
+				return wpOther.lock().get() == &decorator;
+			});
+			if(it != m_unclosedDecorators.end())
+				m_unclosedDecorators.erase(it);
+		}
+		else
+		{
+			auto it = m_decoratorLineSpans.find(*decorator.m_lineSpan);
+			if(it != m_decoratorLineSpans.end() && --it->second == 0)
+				m_decoratorLineSpans.erase(it);
+		}
+	}
+	decorator.m_lineSpan = lineSpan;
+	if(lineSpan.has_value())
+	{
+		if(*lineSpan == unclosedSpan)
+			m_unclosedDecorators.push_back(decorator.weak_from_this());
+		else
+			++m_decoratorLineSpans[*lineSpan];
+	}
+	m_maxDecoratorLineSpan = m_decoratorLineSpans.empty() ? 0 : m_decoratorLineSpans.rbegin()->first;
+}
+
+void WIText::OnDecoratorRemoved(WITextDecorator &decorator)
+{
+	SetDecoratorLineSpan(decorator,{});
+	if(decorator.IsInteractive())
+	{
+		if(m_numInteractiveDecorators > 0)
+			--m_numInteractiveDecorators;
+		m_flags |= Flags::DecorationsDirty;
+	}
+	SetFlag(Flags::ApplySubTextTags);
+}
+
+void WIText::OnDecoratorRangeChanged(WITextDecorator &decorator)
+{
+	// Keep m_tagInfos sorted by the start offset
+	auto it = std::find_if(m_tagInfos.begin(),m_tagInfos.end(),[&decorator](const std::shared_ptr<WITextDecorator> &decoOther) {
+		return decoOther.get() == &decorator;
+	});
+	if(it == m_tagInfos.end())
+		return;
+	auto pDecorator = *it;
+	m_tagInfos.erase(it);
+	auto startOffset = decorator.GetStartTextCharOffset();
+	auto itInsert = std::lower_bound(m_tagInfos.begin(),m_tagInfos.end(),startOffset,[](const std::shared_ptr<WITextDecorator> &decoratorOther,util::text::TextOffset offset) {
+		return decoratorOther->GetStartTextCharOffset() < offset;
+	});
+	m_tagInfos.insert(itInsert,pDecorator);
+}
+
+void WIText::MarkDecoratorDirty(WITextDecorator &decorator)
+{
+	m_dirtyDecorators.push_back(decorator.weak_from_this());
+	SetFlag(Flags::ApplySubTextTags);
+}
 
 Color WIText::GetCharColor(util::text::TextOffset offset) const
 {
@@ -122,10 +267,202 @@ void WIText::ApplySubTextTag(WITextDecorator &tag)
 
 void WIText::ApplySubTextTags()
 {
-	for(auto &tag : m_tagInfos)
+	// Only the decorators that have been marked as dirty are re-applied, so the cost of an edit doesn't depend
+	// on the number of tags in the text
+	auto dirtyDecorators = std::move(m_dirtyDecorators);
+	m_dirtyDecorators.clear();
+	std::vector<std::shared_ptr<WITextDecorator>> decorators {};
+	decorators.reserve(dirtyDecorators.size());
+	for(auto &wpDecorator : dirtyDecorators)
 	{
-		if(tag->IsValid() == false || tag->IsDirty() == false)
+		auto decorator = wpDecorator.lock();
+		if(decorator == nullptr || decorator->IsDirty() == false)
+			continue; // Decorator has been removed or was queued more than once
+		if(decorator->IsValid() == false)
+		{
+			// Will be applied once the tag has been completed
+			m_dirtyDecorators.push_back(decorator);
 			continue;
-		ApplySubTextTag(*tag);
+		}
+		decorators.push_back(decorator);
+	}
+	// Overlapping decorators (e.g. nested color tags) have to be applied in text order. Decorators with the same
+	// start offset keep the order they have been marked in, which is the order of m_tagInfos for all lines
+	// marked by MarkLineTagsDirty.
+	std::stable_sort(decorators.begin(),decorators.end(),[](const std::shared_ptr<WITextDecorator> &a,const std::shared_ptr<WITextDecorator> &b) {
+		return a->GetStartTextCharOffset() < b->GetStartTextCharOffset();
+	});
+	for(auto &decorator : decorators)
+	{
+		ApplySubTextTag(*decorator);
+		if(decorator->IsInteractive())
+			m_flags |= Flags::DecorationsDirty;
+
+		util::text::LineIndex startLineIdx = 0;
+		util::text::LineIndex endLineIdx = 0;
+		util::text::TextOffset startOffset,endOffset;
+		decorator->GetTagRange(startLineIdx,endLineIdx,startOffset,endOffset);
+		if(startOffset == util::text::END_OF_TEXT)
+			SetDecoratorLineSpan(*decorator,{});
+		else if(endOffset == util::text::END_OF_TEXT)
+			SetDecoratorLineSpan(*decorator,std::numeric_limits<util::text::LineIndex>::max()); // Unclosed tags span all following lines
+		else
+			SetDecoratorLineSpan(*decorator,(endLineIdx > startLineIdx) ? (endLineIdx -startLineIdx) : 0);
+	}
+	if(umath::is_flag_set(m_flags,Flags::DecorationsDirty))
+		UpdateDecorations();
+}
+
+void WIText::UpdateDecorations()
+{
+	// Quads are rendered directly from the decorators (see RenderDecorations), only the interactive state has to be updated
+	umath::set_flag(m_flags,Flags::DecorationsDirty,false);
+	auto hasInteractiveDecorators = (m_numInteractiveDecorators > 0);
+	if(hasInteractiveDecorators == umath::is_flag_set(m_flags,Flags::HasInteractiveDecorators))
+		return;
+	umath::set_flag(m_flags,Flags::HasInteractiveDecorators,hasInteractiveDecorators);
+	// Mouse input is only enabled if it isn't already, and only disabled again if it has been enabled here,
+	// so the state set by the owner of the element is kept
+	if(hasInteractiveDecorators)
+	{
+		if(GetMouseInputEnabled() == false)
+		{
+			WIBase::SetMouseInputEnabled(true);
+			umath::set_flag(m_flags,Flags::DecoratorsEnabledMouseInput);
+		}
+		if(GetMouseMovementCheckEnabled() == false)
+		{
+			SetMouseMovementCheckEnabled(true);
+			umath::set_flag(m_flags,Flags::DecoratorsEnabledMouseMovementCheck);
+		}
+		return;
+	}
+	SetHoveredDecorator(nullptr);
+	if(umath::is_flag_set(m_flags,Flags::DecoratorsEnabledMouseInput))
+	{
+		umath::set_flag(m_flags,Flags::DecoratorsEnabledMouseInput,false);
+		WIBase::SetMouseInputEnabled(false);
+	}
+	if(umath::is_flag_set(m_flags,Flags::DecoratorsEnabledMouseMovementCheck))
+	{
+		umath::set_flag(m_flags,Flags::DecoratorsEnabledMouseMovementCheck,false);
+		SetMouseMovementCheckEnabled(false);
 	}
 }
+
+void WIText::SetMouseInputEnabled(bool b)
+{
+	// The owner has taken control of the state, so it's no longer reset once the interactive decorators are gone
+	umath::set_flag(m_flags,Flags::DecoratorsEnabledMouseInput,false);
+	WIBase::SetMouseInputEnabled(b);
+}
+
+WITextDecorator *WIText::FindInteractiveDecorator(const Vector2i &pos)
+{
+	auto lineHeight = (m_font != nullptr) ? GetLineHeight() : 0;
+	if(umath::is_flag_set(m_flags,Flags::HasInteractiveDecorators) == false || lineHeight <= 0 || pos.x < 0 || pos.y < 0)
+		return nullptr;
+	util::text::LineIndex subLineIdx = pos.y /lineHeight;
+	if(subLineIdx >= GetTotalLineCount())
+		return nullptr;
+	auto lineIdx = GetLineIndexFromSubLineIndex(subLineIdx);
+	if(lineIdx >= m_lineInfos.size())
+		return nullptr;
+	auto &lineInfo = m_lineInfos.at(lineIdx);
+	if(lineInfo.wpLine.expired())
+		return nullptr;
+	if(lineInfo.metricsUpdateRequired)
+		UpdateLineMetrics(lineInfo);
+
+	// Find the character under the cursor within the sub-line
+	auto &pxOffsets = lineInfo.charPxOffsets;
+	auto relSubLineIdx = subLineIdx -GetSubLineIndexOffset(lineIdx);
+	auto subLineStart = (relSubLineIdx < lineInfo.subLineOffsets.size()) ? lineInfo.subLineOffsets.at(relSubLineIdx) : 0;
+	auto subLineLen = lineInfo.subLines.empty() ? static_cast<util::text::TextLength>(pxOffsets.size() -1) :
+		((relSubLineIdx < lineInfo.subLines.size()) ? lineInfo.subLines.at(relSubLineIdx) : 0);
+	if(subLineLen == 0 || subLineStart +subLineLen >= pxOffsets.size())
+		return nullptr;
+	auto itStart = pxOffsets.begin() +subLineStart;
+	auto itEnd = itStart +subLineLen +1;
+	auto it = std::upper_bound(itStart,itEnd,*itStart +pos.x);
+	if(it == itEnd)
+		return nullptr; // Cursor is behind the last character
+	util::text::CharOffset charOffset = (it -pxOffsets.begin()) -1;
+
+	auto &line = *lineInfo.wpLine.lock();
+	WITextDecorator *result = nullptr;
+	IterateDecorators(lineIdx,lineIdx,[&line,charOffset,&result](WITextDecorator &decorator) {
+		if(decorator.IsInteractive() == false || decorator.IsValid() == false)
+			return true;
+		util::text::CharOffset tagStartOffset,tagEndOffset;
+		if(decorator.GetTagRange(line,charOffset,charOffset,tagStartOffset,tagEndOffset) <= 0)
+			return true;
+		result = &decorator;
+		return false;
+	});
+	return result;
+}
+void WIText::SetHoveredDecorator(WITextDecorator *decorator)
+{
+	auto *hoveredDecorator = m_hoveredDecorator.lock().get();
+	if(decorator == hoveredDecorator)
+		return;
+	m_hoveredDecorator = (decorator != nullptr) ? decorator->weak_from_this() : std::weak_ptr<WITextDecorator>{};
+
+	// Decorators without a cursor of their own (e.g. tooltips) keep the cursor of the element
+	auto cursor = (decorator != nullptr) ? decorator->GetCursor() : GLFW::Cursor::Shape::Default;
+	if(cursor != GLFW::Cursor::Shape::Default)
+	{
+		if(m_elementCursor.has_value() == false)
+			m_elementCursor = GetCursor();
+		SetCursor(cursor);
+	}
+	else if(m_elementCursor.has_value())
+	{
+		SetCursor(*m_elementCursor);
+		m_elementCursor = {};
+	}
+
+	auto tooltip = (decorator != nullptr) ? decorator->GetTooltip() : std::string{};
+	if(tooltip.empty() == false)
+	{
+		if(m_elementTooltip.has_value() == false)
+			m_elementTooltip = GetTooltip();
+		SetTooltip(tooltip);
+	}
+	else if(m_elementTooltip.has_value())
+	{
+		SetTooltip(*m_elementTooltip);
+		m_elementTooltip = {};
+	}
+}
+void WIText::OnCursorMoved(int x,int y)
+{
+	WIBase::OnCursorMoved(x,y);
+	SetHoveredDecorator(FindInteractiveDecorator({x,y}));
+}
+void WIText::OnCursorEntered()
+{
+	WIBase::OnCursorEntered();
+	// Mouse movement is only checked while thinking
+	if(umath::is_flag_set(m_flags,Flags::HasInteractiveDecorators))
+		EnableThinking();
+}
+void WIText::OnCursorExited()
+{
+	WIBase::OnCursorExited();
+	SetHoveredDecorator(nullptr);
+}
+util::EventReply WIText::MouseCallback(GLFW::MouseButton button,GLFW::KeyState state,GLFW::Modifier mods)
+{
+	auto hThis = GetHandle();
+	auto reply = WIBase::MouseCallback(button,state,mods);
+	if(reply == util::EventReply::Handled || hThis.IsValid() == false)
+		return reply;
+	if(button != GLFW::MouseButton::Left || state != GLFW::KeyState::Release)
+		return reply;
+	int32_t x,y;
+	GetMousePos(&x,&y);
+	auto *decorator = FindInteractiveDecorator({x,y});
+	return (decorator != nullptr) ? decorator->OnClicked() : reply;
+}
@@ -63,6 +63,8 @@ void WITextEntryBase::OnTextChanged(const std::string &text,bool changedByUser)
 		return;
 	if(pText->GetAutoBreakMode() == WIText::AutoBreak::NONE)
 		pText->SizeToContents();
+	if(changedByUser == false)
+		m_editHistory.Clear(); // Recorded offsets are no longer valid
 	CallCallbacks<void,std::reference_wrapper<const std::string>,bool>("OnTextChanged",text,changedByUser);
 }
 
@@ -286,34 +288,13 @@ void WITextEntryBase::SetCaretPos(int pos)
 			if(!IsMultiLine())
 				y = static_cast<int>(static_cast<float>(GetHeight()) *0.5f -static_cast<float>(pCaret->GetHeight()) *0.5f);
 
-			auto lineHeight = pText->GetLineHeight();
-			TextLineIterator lineIt{*pText};
-			auto itEnd = lineIt.end();
-			for(auto it=lineIt.begin();it!=itEnd;)
+			auto lineIdx = pText->GetLineIndexFromTextOffset(pos);
+			if(lineIdx != util::text::INVALID_LINE_INDEX)
 			{
-				auto itNext = it;
-				++itNext;
-
-				// Check if pos is in bounds of line
-				auto &lineInfo = *it;
-				if(itNext == itEnd || (lineInfo.charCountSubLine > 0 && pos >= lineInfo.GetAbsCharStartOffset() && pos < lineInfo.GetAbsCharStartOffset() +lineInfo.charCountSubLine))
-				{
-					int32_t w = 0;
-					auto relPos = pos -lineInfo.GetAbsCharStartOffset();
-					auto startOffset = lineInfo.relCharStartOffset;
-					auto text = std::string_view{lineInfo.line->GetFormattedLine().GetText()}.substr(startOffset,relPos);
-					std::string strHidden;
-					if(IsInputHidden())
-					{
-						strHidden = std::string(text.length(),'*');
-						text = strHidden;
-					}
-					FontManager::GetTextSize(text,startOffset,pText->GetFont(),&w,nullptr);
-					x = w;
-					y = lineInfo.absSubLineIndex *lineHeight;
-					break;
-				}
-				it = itNext;
+				auto charOffset = pos -pText->GetLineStartOffset(lineIdx);
+				auto subLineIdx = pText->GetSubLineIndexOffset(lineIdx) +pText->GetSubLineIndex(lineIdx,charOffset);
+				x = pText->GetCharPixelOffset(lineIdx,charOffset);
+				y = subLineIdx *pText->GetLineHeight();
 			}
 			if(IsMultiLine())
 				y += 2; // TODO: Why is this required?
@@ -344,75 +325,16 @@ int WITextEntryBase::GetCharPos(int x,int y) const
 		WIText *pText = m_hText.get<WIText>();
 		x -= pText->GetX(); // Account for text offset to the left / right
 		int lHeight = pText->GetLineHeight();
-		auto &lines = pText->GetLines();
-		int line = y /lHeight;
-
-		TextLineIterator lineIt{*pText};
-		auto itLine = std::find_if(lineIt.begin(),lineIt.end(),[line](const TextLineIteratorBase::Info &lineInfo) {
-			return lineInfo.absSubLineIndex == line;
-		});
-		if(itLine != lineIt.end())
-		{
-			auto &lineInfo = *itLine;
-
-			if(IsInputHidden())
-			{
-				auto len = lineInfo.line->GetUnformattedLine().GetLength();
-				auto c = '*';
-				int32_t width = 0;
-				int32_t height = 0;
-				FontManager::GetTextSize(c,0,pText->GetFont(),&width,&height);
-				auto charPos = x /static_cast<float>(width);
-				auto charIdx = umath::floor(charPos);
-				charPos -= charIdx;
-				if(charPos >= 0.5f)
-					++charIdx;
-				return charIdx;
-			}
-
-			CharIterator charIt{*pText,lineInfo,true /* updatePixelWidth */};
-			auto itChar = std::find_if(charIt.begin(),charIt.end(),[x](const CharIteratorBase::Info &charInfo) {
-				return x < charInfo.pxOffset +charInfo.pxWidth *0.5f;
-			});
-			if(itChar != charIt.end())
-			{
-				auto &charInfo = *itChar;
-				return charInfo.charOffsetRelToText;
-			}
-			auto charPos = lineInfo.GetAbsCharStartOffset() +lineInfo.charCountSubLine;
-			//if(lineInfo.isLastSubLine == false)
-				--charPos;
-			return charPos;
-		}
-
-		/*
-		size_t pos = 0;
-		if(line < lines.size())
-		{
-			for(int i=0;i<line;i++)
-			{
-				auto &lineInfo = lines.at(i);
-				if(lineInfo.wpLine.expired())
-					continue;
-				pos += lineInfo.wpLine.lock()->GetAbsFormattedLength();
-			}
-			const auto &lineInfo = lines.at(line);
-			auto line = lineInfo.wpLine.lock();
-			auto &strLine = line->GetFormattedLine().GetText();
-			auto offsetInLine = 0u;
-			for(unsigned int i=0;i<strLine.length();i++)
-			{
-				int width,height;
-				auto charWidth = FontManager::GetTextSize(strLine.at(i),offsetInLine,pText->GetFont(),&width,&height);
-				if(x < width *0.5)
-					break;
-				++pos;
-				x -= width;
-				offsetInLine += charWidth;
-			}
-			return pos;
-		}*/
-		return -1;
+		if(lHeight <= 0 || y < 0)
+			return -1;
+		util::text::LineIndex subLineIdx = y /lHeight;
+		if(subLineIdx >= pText->GetTotalLineCount())
+			return -1;
+		auto lineIdx = pText->GetLineIndexFromSubLineIndex(subLineIdx);
+		if(lineIdx >= pText->GetLineCount())
+			return -1;
+		auto relSubLineIdx = subLineIdx -pText->GetSubLineIndexOffset(lineIdx);
+		return pText->GetLineStartOffset(lineIdx) +pText->FindCharOffset(lineIdx,relSubLineIdx,x);
 	}
 	return -1;
 }
@@ -514,16 +436,19 @@ void WITextEntryBase::UpdateSelection()
 		return;
 	}
 
-	if(m_selectionDecorator == nullptr)
-		m_selectionDecorator = GetTextElement()->AddDecorator<WITextTagSelection>(start,end);
+	auto *pText = GetTextElement();
+	if(pText == nullptr)
+		return;
+	// The existing selection is moved, which keeps its anchor points
+	if(m_selectionDecorator && m_selectionDecorator->IsValid())
+		static_cast<WITextTagSelection&>(*m_selectionDecorator).SetRange(start,end);
 	else
 	{
-		auto &tagSelection = static_cast<WITextTagSelection&>(*m_selectionDecorator.get());
-		tagSelection.SetStartOffset(start);
-		tagSelection.SetEndOffset(end);
+		if(m_selectionDecorator)
+			pText->RemoveDecorator(*m_selectionDecorator);
+		m_selectionDecorator = pText->AddDecorator<WITextTagSelection>(start,end);
 	}
-	m_selectionDecorator->SetDirty();
-	GetTextElement()->UpdateTags();
+	pText->UpdateTags();
 }
 
 void WITextEntryBase::SetSelectionBounds(int start,int end)
@@ -555,22 +480,18 @@ std::pair<util::text::LineIndex,util::text::LineIndex> WITextEntryBase::GetLineI
 		return {util::text::INVALID_LINE_INDEX,util::text::INVALID_LINE_INDEX};
 	WIText *pText = m_hText.get<WIText>();
 
-	TextLineIterator lineIt{*pText};
-	for(auto &lineInfo : lineIt)
-	{
-		if(lineInfo.line == nullptr)
-			continue;
-		auto &strLine = lineInfo.line->GetFormattedLine().GetText();
-		int len = lineInfo.charCountSubLine;
-		if(pos < len)
-		{
-			outLine = std::string_view{strLine}.substr(lineInfo.relCharStartOffset,len);
-			*lpos = pos;
-			return {lineInfo.lineIndex,lineInfo.relSubLineIndex};
-		}
-		pos -= len;
-	}
-	return {util::text::INVALID_LINE_INDEX,util::text::INVALID_LINE_INDEX};
+	auto lineIdx = pText->GetLineIndexFromTextOffset(pos);
+	auto *pLine = (lineIdx != util::text::INVALID_LINE_INDEX) ? pText->GetLine(lineIdx) : nullptr;
+	if(pLine == nullptr)
+		return {util::text::INVALID_LINE_INDEX,util::text::INVALID_LINE_INDEX};
+	auto &lineInfo = pText->GetLines().at(lineIdx);
+	util::text::CharOffset charOffset = pos -pText->GetLineStartOffset(lineIdx);
+	auto relSubLineIdx = pText->GetSubLineIndex(lineIdx,charOffset);
+	auto subLineStart = lineInfo.subLineOffsets.empty() ? 0 : lineInfo.subLineOffsets.at(relSubLineIdx);
+	auto subLineLen = lineInfo.subLines.empty() ? util::text::LAST_CHAR : lineInfo.subLines.at(relSubLineIdx);
+	outLine = std::string_view{pLine->GetFormattedLine().GetText()}.substr(subLineStart,subLineLen);
+	*lpos = charOffset -subLineStart;
+	return {lineIdx,relSubLineIdx};
 }
 
 bool WITextEntryBase::RemoveSelectedText()
@@ -588,6 +509,7 @@ bool WITextEntryBase::RemoveSelectedText()
 	auto enOffset = formattedText.GetUnformattedTextOffset(en -1u);
 	if(stOffset.has_value() == false || enOffset.has_value() == false)
 		return false;
+	m_editHistory.Record(st,std::string_view{pText->GetFormattedText()}.substr(st,en -st),{});
 	st = *stOffset;
 	en = *enOffset;
 
@@ -629,6 +551,7 @@ util::EventReply WITextEntryBase::KeyboardCallback(GLFW::Key key,int scanCode,GL
 								auto prevPos = formattedText.GetUnformattedTextOffset(pos -1);
 								if(prevPos.has_value())
 								{
+									m_editHistory.Record(pos -1,std::string_view{pText->GetFormattedText()}.substr(pos -1,1),{});
 									pText->RemoveText(*prevPos,1);
 									OnTextChanged(true);
 									SetCaretPos(*prevPos);
@@ -640,6 +563,7 @@ util::EventReply WITextEntryBase::KeyboardCallback(GLFW::Key key,int scanCode,GL
 							int pos = GetCaretPos();
 							if(pos < text.length())
 							{
+								m_editHistory.Record(pos,std::string_view{pText->GetFormattedText()}.substr(pos,1),{});
 								pText->RemoveText(pos,1);
 								OnTextChanged(true);
 							}
@@ -683,42 +607,19 @@ util::EventReply WITextEntryBase::KeyboardCallback(GLFW::Key key,int scanCode,GL
 					auto curLine = GetLineInfo(pos,line,&lpos);
 					if(curLine.first != util::text::INVALID_LINE_INDEX)
 					{
-						int lenOfSubStringUpToCaret;
-						FontManager::GetTextSize(ustring::substr(line,0,lpos),0u,pText->GetFont(),&lenOfSubStringUpToCaret);
-
-						TextLineIterator lineIt {*pText,curLine.first,curLine.second};
-						auto it = lineIt.begin();
+						auto caretPxOffset = pText->GetCharPixelOffset(curLine.first,pos -pText->GetLineStartOffset(curLine.first));
+						auto subLineIdx = pText->GetSubLineIndexOffset(curLine.first) +curLine.second;
 						if(key == GLFW::Key::Down)
-							++it;
+							++subLineIdx;
 						else
-							--it;
-						if(it != lineIt.end())
+							--subLineIdx;
+						if(subLineIdx < pText->GetTotalLineCount())
 						{
-							auto &newLineInfo = *it;
-							
-							auto &formattedText = pText->GetFormattedTextObject();
-							auto *pLine = formattedText.GetLine(newLineInfo.lineIndex);
-							if(pLine)
+							auto newLineIdx = pText->GetLineIndexFromSubLineIndex(subLineIdx);
+							if(newLineIdx < pText->GetLineCount())
 							{
-								CharIterator charIt {*pText,newLineInfo,true /* updatePixelWidth */};
-								auto newPos = util::text::LAST_CHAR;
-								for(auto &charInfo : charIt)
-								{
-									auto endOffset = charInfo.pxOffset +charInfo.pxWidth *0.5;
-									if(endOffset < lenOfSubStringUpToCaret || (key == GLFW::Key::Up && endOffset == lenOfSubStringUpToCaret))
-										continue;
-									auto formattedPos = formattedText.GetFormattedTextOffset(pLine->GetStartOffset());
-									if(formattedPos.has_value())
-										newPos = *formattedPos +charInfo.charOffsetRelToLine;
-									break;
-								}
-								if(newPos == util::text::LAST_CHAR)
-								{
-									auto formattedPos = formattedText.GetFormattedTextOffset(pLine->GetStartOffset());
-									if(formattedPos.has_value())
-										newPos = *formattedPos +pLine->GetFormattedLength();
-								}
-
+								auto relSubLineIdx = subLineIdx -pText->GetSubLineIndexOffset(newLineIdx);
+								int newPos = pText->GetLineStartOffset(newLineIdx) +pText->FindCharOffset(newLineIdx,relSubLineIdx,caretPxOffset);
 								SetCaretPos(newPos);
 								if((mods &GLFW::Modifier::Shift) == GLFW::Modifier::Shift)
 								{
@@ -810,6 +711,17 @@ util::EventReply WITextEntryBase::KeyboardCallback(GLFW::Key key,int scanCode,GL
 				}
 				break;
 			}
+		case GLFW::Key::Z:
+		case GLFW::Key::Y:
+			{
+				if(IsEditable() == false || (mods &GLFW::Modifier::Control) != GLFW::Modifier::Control)
+					break;
+				if(key == GLFW::Key::Y || (mods &GLFW::Modifier::Shift) == GLFW::Modifier::Shift)
+					Redo();
+				else
+					Undo();
+				break;
+			}
 		case GLFW::Key::Tab:
 			return CharCallback('\t',mods);
 		default:
@@ -860,11 +772,13 @@ util::EventReply WITextEntryBase::OnDoubleClick()
 	return util::EventReply::Handled;
 }
 
-void WITextEntryBase::InsertText(const std::string_view &instext,int pos)
+void WITextEntryBase::InsertText(const std::string_view &instext,int pos) {InsertText(instext,pos,false);}
+void WITextEntryBase::InsertText(const std::string_view &instext,int pos,bool mergeEdit)
 {
 	auto *pText = GetTextElement();
 	if(pText == nullptr)
 		return;
+	m_editHistory.Record(umath::clamp(pos,0,static_cast<int32_t>(pText->GetFormattedText().length())),{},instext,mergeEdit);
 	auto &formattedText = pText->GetFormattedTextObject();
 	auto relOffset = formattedText.GetRelativeCharOffset(pos);
 	if(relOffset.has_value())
@@ -878,9 +792,64 @@ void WITextEntryBase::InsertText(const std::string_view &instext,int pos)
 
 void WITextEntryBase::InsertText(const std::string_view &text)
 {
-	RemoveSelectedText();
-	InsertText(text,GetCaretPos());
+	auto selectionRemoved = RemoveSelectedText();
+	// Typed characters are merged into a single edit per word
+	auto mergeEdit = selectionRemoved == false && text.length() == 1 && text.front() != ' ' && text.front() != '\t' && text.front() != '\n';
+	InsertText(text,GetCaretPos(),mergeEdit);
+}
+
+void WITextEntryBase::ApplyEdit(int offset,int len,const std::string_view &text)
+{
+	auto *pText = GetTextElement();
+	if(pText == nullptr)
+		return;
+	auto &formattedText = pText->GetFormattedTextObject();
+	pText->BeginTextEdit();
+	if(len > 0)
+	{
+		auto stOffset = formattedText.GetUnformattedTextOffset(offset);
+		auto enOffset = formattedText.GetUnformattedTextOffset(offset +len -1);
+		if(stOffset.has_value() && enOffset.has_value())
+			pText->RemoveText(*stOffset,*enOffset -*stOffset +1);
+	}
+	if(text.empty() == false)
+	{
+		auto relOffset = formattedText.GetRelativeCharOffset(offset);
+		if(relOffset.has_value())
+			pText->InsertText(text,relOffset->first,relOffset->second);
+		else
+			pText->AppendText(text);
+	}
+	pText->EndTextEdit();
+	OnTextChanged(true);
+}
+
+bool WITextEntryBase::Undo()
+{
+	auto *pEdit = m_editHistory.Undo();
+	if(pEdit == nullptr)
+		return false;
+	// Copied, since the history may be cleared by the OnTextChanged callbacks
+	auto edit = *pEdit;
+	std::string text {m_editHistory.GetRemovedText(edit)};
+	ClearSelection();
+	ApplyEdit(edit.offset,edit.insertedLength,text);
+	SetCaretPos(edit.offset +edit.removedLength);
+	return true;
+}
+bool WITextEntryBase::Redo()
+{
+	auto *pEdit = m_editHistory.Redo();
+	if(pEdit == nullptr)
+		return false;
+	auto edit = *pEdit;
+	std::string text {m_editHistory.GetInsertedText(edit)};
+	ClearSelection();
+	ApplyEdit(edit.offset,edit.removedLength,text);
+	SetCaretPos(edit.offset +edit.insertedLength);
+	return true;
 }
+TextEditHistory &WITextEntryBase::GetEditHistory() {return m_editHistory;}
 
 bool WITextEntryBase::IsNumeric() const {return umath::is_flag_set(m_stateFlags,StateFlags::Numeric);}
 void WITextEntryBase::SetNumeric(bool bNumeric)
@@ -240,6 +240,8 @@ void WITexturedShape::DoUpdate()
 	createInfo.usageFlags = prosper::BufferUsageFlags::VertexBufferBit;
 	createInfo.size = m_uvs.size() *sizeof(Vector2);
 	createInfo.memoryFeatures = prosper::MemoryFeatureFlags::DeviceLocal;
+	if(m_uvBuffer != nullptr)
+		context.KeepResourceAliveUntilPresentationComplete(m_uvBuffer);
 	m_uvBuffer = context.CreateBuffer(createInfo,m_uvs.data());
 }
 void WITexturedShape::SetChannelSwizzle(wgui::ShaderTextured::Channel dst,wgui::ShaderTextured::Channel src)
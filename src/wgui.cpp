@@ -12,6 +12,8 @@
 #include "wgui/wiskin.h"
 #include "wgui/types/wiarrow.h"
 #include "wgui/types/witext.h"
+#include "wgui/types/witext_batcher.hpp"
+#include "wgui/wiupload_manager.hpp"
 #include "wgui/shaders/wishader_colored.hpp"
 #include "wgui/shaders/wishader_coloredline.hpp"
 #include "wgui/shaders/wishader_text.hpp"
@@ -65,7 +67,12 @@ wgui::ShaderColoredRect *WGUI::GetColoredRectShader() {return static_cast<wgui::
 wgui::ShaderColoredLine *WGUI::GetColoredLineShader() {return static_cast<wgui::ShaderColoredLine*>(m_shaderColoredLine.get());}
 wgui::ShaderText *WGUI::GetTextShader() {return static_cast<wgui::ShaderText*>(m_shaderText.get());}
 wgui::ShaderTextRect *WGUI::GetTextRectShader() {return static_cast<wgui::ShaderTextRect*>(m_shaderTextCheap.get());}
-wgui::ShaderTextRectColor *WGUI::GetTextRectColorShader() {return static_cast<wgui::ShaderTextRectColor*>(m_shaderTextCheapColor.get());}
+wgui::ShaderTextRectColor *WGUI::GetTextRectColorShader() {return GetTextRectShader();}
+wgui::ShaderTextBatch *WGUI::GetTextBatchShader()
+{
+	auto *shader = static_cast<wgui::ShaderTextBatch*>(m_shaderTextBatch.get());
+	return (shader != nullptr && shader->IsValid()) ? shader : nullptr;
+}
 wgui::ShaderTextured *WGUI::GetTexturedShader() {return static_cast<wgui::ShaderTextured*>(m_shaderTextured.get());}
 wgui::ShaderTexturedRect *WGUI::GetTexturedRectShader() {return static_cast<wgui::ShaderTexturedRect*>(m_shaderTexturedCheap.get());}
 
@@ -107,7 +114,7 @@ WGUI::ResultCode WGUI::Initialize(std::optional<Vector2i> resolution)
 	m_shaderColoredLine = shaderManager.RegisterShader("wguicoloredline",[](prosper::IPrContext &context,const std::string &identifier) {return new wgui::ShaderColoredLine(context,identifier);});
 	m_shaderText = shaderManager.RegisterShader("wguitext",[](prosper::IPrContext &context,const std::string &identifier) {return new wgui::ShaderText(context,identifier);});
 	m_shaderTextCheap = shaderManager.RegisterShader("wguitext_cheap",[](prosper::IPrContext &context,const std::string &identifier) {return new wgui::ShaderTextRect(context,identifier);});
-	m_shaderTextCheapColor = shaderManager.RegisterShader("wguitext_cheap_color",[](prosper::IPrContext &context,const std::string &identifier) {return new wgui::ShaderTextRectColor(context,identifier);});
+	m_shaderTextBatch = shaderManager.RegisterShader("wguitext_batch",[](prosper::IPrContext &context,const std::string &identifier) {return new wgui::ShaderTextBatch(context,identifier);});
 	m_shaderTextured = shaderManager.RegisterShader("wguitextured",[](prosper::IPrContext &context,const std::string &identifier) {return new wgui::ShaderTextured(context,identifier);});
 	m_shaderTexturedCheap = shaderManager.RegisterShader("wguitextured_cheap",[](prosper::IPrContext &context,const std::string &identifier) {return new wgui::ShaderTexturedRect(context,identifier);});
 	
@@ -188,6 +195,7 @@ void WGUI::Think()
 			hEl->Remove();
 		m_removeQueue.pop();
 	}
+	UpdateLayout();
 
 	if(m_bGUIUpdateRequired && m_base.IsValid())
 	{
@@ -231,6 +239,10 @@ void WGUI::Think()
 		if(i < m_thinkingElements.size() && m_thinkingElements.at(i).get() == pEl)
 			++i;
 	}
+	// Blurred text shadows that have been re-rendered by the elements above are blurred in one go
+	WIText::FlushBlurredShadows();
+	// All buffer updates of this frame are transferred before the GUI is rendered
+	GetUploadManager().Flush();
 
 	auto *el = GetCursorGUIElement(GetBaseElement(),[](WIBase *el) -> bool {return true;});
 	while(el && el->GetCursor() == GLFW::Cursor::Shape::Default)
@@ -238,6 +250,70 @@ void WGUI::Think()
 	SetCursor(el ? el->GetCursor() : GLFW::Cursor::Shape::Arrow);
 }
 
+void WGUI::BeginLayoutTransaction() {++m_layoutTransactionDepth;}
+void WGUI::EndLayoutTransaction()
+{
+	if(m_layoutTransactionDepth > 0)
+		--m_layoutTransactionDepth;
+}
+bool WGUI::IsLayoutTransactionActive() const {return m_layoutTransactionDepth > 0;}
+void WGUI::ScheduleElementForLayout(WIBase &el) {m_layoutQueue.push_back(el.GetHandle());}
+void WGUI::ScheduleElementForAutoSize(WIBase &el) {m_autoSizeQueue.push_back(el.GetHandle());}
+void WGUI::UpdateLayout()
+{
+	if(m_layoutQueue.empty() || IsLayoutTransactionActive() || m_layoutPassActive)
+		return;
+	// Parents are updated before their children, so children that are anchored to their parent are only moved once
+	std::vector<std::pair<uint32_t,WIHandle>> elements {};
+	elements.reserve(m_layoutQueue.size());
+	for(auto &hEl : m_layoutQueue)
+	{
+		if(hEl.IsValid() == false)
+			continue;
+		uint32_t depth = 0u;
+		for(auto *parent=hEl->GetParent();parent!=nullptr;parent=parent->GetParent())
+			++depth;
+		elements.push_back({depth,hEl});
+	}
+	m_layoutQueue.clear();
+	std::stable_sort(elements.begin(),elements.end(),[](const std::pair<uint32_t,WIHandle> &a,const std::pair<uint32_t,WIHandle> &b) {
+		return a.first < b.first;
+	});
+	m_layoutPassActive = true;
+	for(auto &pair : elements)
+	{
+		if(pair.second.IsValid())
+			pair.second->ResolveLayout();
+	}
+
+	// Auto-sizing is resolved bottom-up, so every element is resized once, after the sizes of its children are known.
+	// Resizing an element queues its own parent, which is resolved in the next iteration (unless it's already queued).
+	std::vector<std::pair<uint32_t,WIHandle>> autoSizeElements {};
+	while(m_autoSizeQueue.empty() == false)
+	{
+		autoSizeElements.clear();
+		for(auto &hEl : m_autoSizeQueue)
+		{
+			if(hEl.IsValid() == false)
+				continue;
+			uint32_t depth = 0u;
+			for(auto *parent=hEl->GetParent();parent!=nullptr;parent=parent->GetParent())
+				++depth;
+			autoSizeElements.push_back({depth,hEl});
+		}
+		m_autoSizeQueue.clear();
+		std::stable_sort(autoSizeElements.begin(),autoSizeElements.end(),[](const std::pair<uint32_t,WIHandle> &a,const std::pair<uint32_t,WIHandle> &b) {
+			return a.first > b.first;
+		});
+		for(auto &pair : autoSizeElements)
+		{
+			if(pair.second.IsValid())
+				pair.second->ResolveAutoSizeToContents();
+		}
+	}
+	m_layoutPassActive = false;
+}
+
 void WGUI::ScheduleElementForUpdate(WIBase &el)
 {
 	m_bGUIUpdateRequired = true;
@@ -267,9 +343,28 @@ void WGUI::Draw()
 	WIBase::RENDER_ALPHA = 1.f;
 	if(!m_base.IsValid())
 		return;
+	UpdateLayout();
 	auto *p = m_base.get();
-	if(p->IsVisible())
-		p->Draw(p->GetWidth(),p->GetHeight());
+	if(p->IsVisible() == false)
+		return;
+	if(m_textBatcher == nullptr)
+		m_textBatcher = std::make_unique<TextBatcher>();
+	m_textBatcher->Begin();
+	p->Draw(p->GetWidth(),p->GetHeight());
+	m_textBatcher->End();
+}
+
+TextBatcher *WGUI::GetTextBatcher() {return (m_textBatcher != nullptr && m_textBatcher->IsActive()) ? m_textBatcher.get() : nullptr;}
+void WGUI::FlushTextBatch()
+{
+	if(m_textBatcher != nullptr)
+		m_textBatcher->Flush();
+}
+UploadManager &WGUI::GetUploadManager()
+{
+	if(m_uploadManager == nullptr)
+		m_uploadManager = std::make_unique<UploadManager>();
+	return *m_uploadManager;
 }
 
 WIBase *WGUI::Create(std::string classname,WIBase *parent)
@@ -67,31 +67,20 @@ WIBase::WIBase()
 
 	//auto hThis = GetHandle();
 	m_pos->AddCallback([this](std::reference_wrapper<const Vector2i> oldPos,std::reference_wrapper<const Vector2i> pos) {
-		for(auto &pair : m_attachments)
-			pair.second->UpdateAbsolutePosition();
-		if(umath::is_flag_set(m_stateFlags,StateFlags::UpdatingAnchorTransform) == false)
+		if(WGUI::GetInstance().IsLayoutTransactionActive())
 		{
-			UpdateAnchorTopLeftPixelOffsets();
-			UpdateAnchorBottomRightPixelOffsets();
+			ScheduleLayoutUpdate(StateFlags::LayoutPosPending);
+			return;
 		}
-		CallCallbacks<void>("SetPos");
-
-		UpdateParentAutoSizeToContents();
+		ApplyPosChange();
 	});
 	m_size->AddCallback([this](std::reference_wrapper<const Vector2i> oldSize,std::reference_wrapper<const Vector2i> size) {
-		for(auto &pair : m_attachments)
-			pair.second->UpdateAbsolutePosition();
-		if(umath::is_flag_set(m_stateFlags,StateFlags::UpdatingAnchorTransform) == false)
-			UpdateAnchorBottomRightPixelOffsets();
-		CallCallbacks<void>("SetSize");
-		for(auto &hChild : m_children)
+		if(WGUI::GetInstance().IsLayoutTransactionActive())
 		{
-			if(hChild.IsValid() == false)
-				continue;
-			hChild->UpdateAnchorTransform();
+			ScheduleLayoutUpdate(StateFlags::LayoutSizePending);
+			return;
 		}
-
-		UpdateParentAutoSizeToContents();
+		ApplySizeChange();
 	});
 	m_bVisible->AddCallback([this](std::reference_wrapper<const bool> oldVisible,std::reference_wrapper<const bool> visible) {
 		UpdateVisibility();
@@ -120,6 +109,51 @@ WIBase::~WIBase()
 	}
 	m_fade = nullptr;
 }
+void WIBase::ApplyPosChange()
+{
+	umath::set_flag(m_stateFlags,StateFlags::LayoutPosPending,false);
+	for(auto &pair : m_attachments)
+		pair.second->UpdateAbsolutePosition();
+	if(umath::is_flag_set(m_stateFlags,StateFlags::UpdatingAnchorTransform) == false)
+	{
+		UpdateAnchorTopLeftPixelOffsets();
+		UpdateAnchorBottomRightPixelOffsets();
+	}
+	CallCallbacks<void>("SetPos");
+
+	UpdateParentAutoSizeToContents();
+}
+void WIBase::ApplySizeChange()
+{
+	umath::set_flag(m_stateFlags,StateFlags::LayoutSizePending,false);
+	for(auto &pair : m_attachments)
+		pair.second->UpdateAbsolutePosition();
+	if(umath::is_flag_set(m_stateFlags,StateFlags::UpdatingAnchorTransform) == false)
+		UpdateAnchorBottomRightPixelOffsets();
+	CallCallbacks<void>("SetSize");
+	for(auto &hChild : m_children)
+	{
+		if(hChild.IsValid() == false)
+			continue;
+		hChild->UpdateAnchorTransform();
+	}
+
+	UpdateParentAutoSizeToContents();
+}
+void WIBase::ScheduleLayoutUpdate(StateFlags flag)
+{
+	if(umath::is_flag_set(m_stateFlags,StateFlags::LayoutPosPending | StateFlags::LayoutSizePending) == false)
+		WGUI::GetInstance().ScheduleElementForLayout(*this);
+	umath::set_flag(m_stateFlags,flag);
+}
+void WIBase::ResolveLayout()
+{
+	// The element may have been updated in the meantime by the layout of one of its parents
+	if(umath::is_flag_set(m_stateFlags,StateFlags::LayoutPosPending))
+		ApplyPosChange();
+	if(umath::is_flag_set(m_stateFlags,StateFlags::LayoutSizePending))
+		ApplySizeChange();
+}
 void WIBase::UpdateParentAutoSizeToContents()
 {
 	if(m_parent == nullptr || umath::is_flag_set(m_parent->m_stateFlags,StateFlags::AutoSizeToContentsX | StateFlags::AutoSizeToContentsY) == false || IsBackgroundElement())
@@ -138,8 +172,34 @@ void WIBase::UpdateParentAutoSizeToContents()
 		if(top != bottom) // Vertical axis anchor
 			updateY = false;
 	}
+	if(WGUI::GetInstance().m_layoutPassActive)
+	{
+		// Deferred until the geometry of all queued elements has been applied, otherwise the parent would be resized
+		// once for every child
+		if(updateX || updateY)
+			m_parent->ScheduleAutoSizeToContents(updateX,updateY);
+		return;
+	}
 	m_parent->UpdateAutoSizeToContents(updateX,updateY);
 }
+void WIBase::ScheduleAutoSizeToContents(bool updateX,bool updateY)
+{
+	if(umath::is_flag_set(m_stateFlags,StateFlags::LayoutAutoSizeXPending | StateFlags::LayoutAutoSizeYPending) == false)
+		WGUI::GetInstance().ScheduleElementForAutoSize(*this);
+	if(updateX)
+		umath::set_flag(m_stateFlags,StateFlags::LayoutAutoSizeXPending);
+	if(updateY)
+		umath::set_flag(m_stateFlags,StateFlags::LayoutAutoSizeYPending);
+}
+void WIBase::ResolveAutoSizeToContents()
+{
+	auto updateX = umath::is_flag_set(m_stateFlags,StateFlags::LayoutAutoSizeXPending);
+	auto updateY = umath::is_flag_set(m_stateFlags,StateFlags::LayoutAutoSizeYPending);
+	// The flags are cleared afterwards, so that children which are re-anchored by the resize don't queue this element again
+	if(updateX || updateY)
+		UpdateAutoSizeToContents(updateX,updateY);
+	umath::set_flag(m_stateFlags,StateFlags::LayoutAutoSizeXPending | StateFlags::LayoutAutoSizeYPending,false);
+}
 void WIBase::UpdateAutoSizeToContents(bool updateX,bool updateY)
 {
 	if(umath::is_flag_set(m_stateFlags,StateFlags::AutoSizeToContentsX | StateFlags::AutoSizeToContentsY))
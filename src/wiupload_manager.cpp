@@ -0,0 +1,216 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx_wgui.h"
+#include "wgui/wiupload_manager.hpp"
+#include <prosper_context.hpp>
+#include <prosper_util.hpp>
+#include <prosper_command_buffer.hpp>
+#include <algorithm>
+#include <cstring>
+
+UploadManager::~UploadManager() {Clear();}
+
+bool UploadManager::IsEmpty() const {return m_updates.empty();}
+
+void UploadManager::Clear()
+{
+	m_updates.clear();
+	for(auto &chunk : m_chunks)
+	{
+		if(chunk.buffer != nullptr && WGUI::IsOpen())
+			WGUI::GetInstance().GetContext().KeepResourceAliveUntilPresentationComplete(chunk.buffer);
+	}
+	m_chunks.clear();
+	m_currentChunk = std::numeric_limits<uint32_t>::max();
+}
+
+void UploadManager::KeepChunkAlive(StagingChunk &chunk)
+{
+	// The chunk must not be re-used before the GPU has finished reading from it. The context holds a reference until
+	// the frame has been presented, a chunk is only re-used once it is the sole owner again.
+	auto &context = WGUI::GetInstance().GetContext();
+	auto frameId = context.GetLastFrameId();
+	if(chunk.lastFrameId == frameId)
+		return;
+	chunk.lastFrameId = frameId;
+	context.KeepResourceAliveUntilPresentationComplete(chunk.buffer);
+}
+
+int32_t UploadManager::Allocate(prosper::DeviceSize size,prosper::DeviceSize alignment,prosper::DeviceSize &outOffset)
+{
+	auto fits = [size,alignment](const StagingChunk &chunk,prosper::DeviceSize &outOffset) -> bool {
+		outOffset = (alignment > 1) ? (((chunk.offset +alignment -1) /alignment) *alignment) : chunk.offset;
+		return outOffset +size <= chunk.size;
+	};
+	auto isChunkFree = [](const StagingChunk &chunk) -> bool {
+		return chunk.numPendingUpdates == 0 && chunk.buffer.use_count() == 1;
+	};
+	if(m_currentChunk < m_chunks.size())
+	{
+		auto &chunk = m_chunks.at(m_currentChunk);
+		if(fits(chunk,outOffset))
+			return m_currentChunk;
+	}
+	prosper::DeviceSize totalSize = 0;
+	for(auto i=decltype(m_chunks.size()){0u};i<m_chunks.size();++i)
+	{
+		auto &chunk = m_chunks.at(i);
+		totalSize += chunk.size;
+		if(chunk.buffer == nullptr || chunk.size < size || isChunkFree(chunk) == false)
+			continue;
+		chunk.offset = 0;
+		fits(chunk,outOffset);
+		if(chunk.size == STAGING_CHUNK_SIZE)
+			m_currentChunk = i;
+		return i;
+	}
+	auto chunkSize = std::max(size,STAGING_CHUNK_SIZE);
+	if(totalSize +chunkSize > STAGING_MAX_SIZE)
+	{
+		// Release dedicated chunks that are no longer in use before giving up. The slots are kept, since pending
+		// updates refer to chunks by index.
+		for(auto &chunk : m_chunks)
+		{
+			if(chunk.buffer == nullptr || chunk.size == STAGING_CHUNK_SIZE || isChunkFree(chunk) == false)
+				continue;
+			totalSize -= chunk.size;
+			chunk = {};
+		}
+		if(totalSize +chunkSize > STAGING_MAX_SIZE)
+			return -1;
+	}
+
+	auto &context = WGUI::GetInstance().GetContext();
+	prosper::util::BufferCreateInfo createInfo {};
+	createInfo.usageFlags = prosper::BufferUsageFlags::TransferSrcBit | prosper::BufferUsageFlags::VertexBufferBit | prosper::BufferUsageFlags::StorageBufferBit;
+	createInfo.memoryFeatures = prosper::MemoryFeatureFlags::CPUToGPU | prosper::MemoryFeatureFlags::HostCoherent;
+	createInfo.flags |= prosper::util::BufferCreateInfo::Flags::Persistent;
+	createInfo.size = chunkSize;
+	auto buf = context.CreateBuffer(createInfo);
+	if(buf == nullptr)
+		return -1;
+	void *data = nullptr;
+	if(buf->Map(0ull,chunkSize,prosper::IBuffer::MapFlags::WriteBit | prosper::IBuffer::MapFlags::PersistentBit,&data) == false || data == nullptr)
+		return -1;
+	buf->SetDebugName("gui_upload_staging_buf");
+	auto it = std::find_if(m_chunks.begin(),m_chunks.end(),[](const StagingChunk &chunk) {return chunk.buffer == nullptr;});
+	if(it == m_chunks.end())
+	{
+		m_chunks.push_back({});
+		it = m_chunks.end() -1;
+	}
+	auto &chunk = *it;
+	chunk = {};
+	chunk.buffer = buf;
+	chunk.data = static_cast<uint8_t*>(data);
+	chunk.size = chunkSize;
+	outOffset = 0;
+	auto chunkIdx = it -m_chunks.begin();
+	if(chunkSize == STAGING_CHUNK_SIZE)
+		m_currentChunk = chunkIdx;
+	return chunkIdx;
+}
+
+void *UploadManager::ScheduleUpdate(const std::shared_ptr<prosper::IBuffer> &buffer,prosper::DeviceSize offset,prosper::DeviceSize size)
+{
+	if(buffer == nullptr || size == 0)
+		return nullptr;
+	prosper::DeviceSize srcOffset;
+	auto chunkIdx = Allocate(size,0u,srcOffset);
+	if(chunkIdx == -1)
+		return nullptr;
+	auto &chunk = m_chunks.at(chunkIdx);
+	chunk.offset = srcOffset +size;
+	++chunk.numPendingUpdates;
+	// Sub-buffers of the same dynamic buffer share their memory, so their updates can be merged into the same copy
+	auto parent = buffer->GetParent();
+	auto *rootBuffer = (parent != nullptr) ? &*parent : buffer.get();
+	m_updates.push_back({});
+	auto &update = m_updates.back();
+	update.buffer = buffer;
+	update.rootBuffer = rootBuffer;
+	update.dstOffset = buffer->GetStartOffset() +offset;
+	update.size = size;
+	update.chunkIndex = chunkIdx;
+	update.srcOffset = srcOffset;
+	return chunk.data +srcOffset;
+}
+
+void UploadManager::ScheduleUpdate(const std::shared_ptr<prosper::IBuffer> &buffer,prosper::DeviceSize offset,prosper::DeviceSize size,const void *data)
+{
+	if(buffer == nullptr || size == 0)
+		return;
+	auto *dst = ScheduleUpdate(buffer,offset,size);
+	if(dst == nullptr)
+	{
+		// Staging memory is exhausted; Fall back to an individual update
+		WGUI::GetInstance().GetContext().ScheduleRecordUpdateBuffer(buffer,offset,size,data);
+		return;
+	}
+	memcpy(dst,data,size);
+}
+
+void *UploadManager::AllocateFrameData(prosper::DeviceSize size,prosper::DeviceSize alignment,std::shared_ptr<prosper::IBuffer> &outBuffer,prosper::DeviceSize &outOffset)
+{
+	if(size == 0)
+		return nullptr;
+	auto chunkIdx = Allocate(size,alignment,outOffset);
+	if(chunkIdx == -1)
+		return nullptr;
+	auto &chunk = m_chunks.at(chunkIdx);
+	chunk.offset = outOffset +size;
+	KeepChunkAlive(chunk);
+	outBuffer = chunk.buffer;
+	return chunk.data +outOffset;
+}
+
+void UploadManager::Flush()
+{
+	if(m_updates.empty())
+		return;
+	auto updates = std::move(m_updates);
+	m_updates.clear();
+	auto &context = WGUI::GetInstance().GetContext();
+	std::stable_sort(updates.begin(),updates.end(),[](const Update &a,const Update &b) {
+		return (a.rootBuffer != b.rootBuffer) ? (a.rootBuffer < b.rootBuffer) : (a.dstOffset < b.dstOffset);
+	});
+
+	auto &drawCmd = context.GetDrawCommandBuffer();
+	for(auto it=updates.begin();it!=updates.end();)
+	{
+		auto &first = *it;
+		auto &chunk = m_chunks.at(first.chunkIndex);
+		KeepChunkAlive(chunk);
+		// Updates that are adjacent in both the staging chunk and the destination buffer are transferred with a single copy
+		auto size = first.size;
+		auto itNext = it +1;
+		while(
+			itNext != updates.end() && itNext->rootBuffer == first.rootBuffer && itNext->dstOffset == first.dstOffset +size &&
+			itNext->chunkIndex == first.chunkIndex && itNext->srcOffset == first.srcOffset +size
+		)
+		{
+			size += itNext->size;
+			++itNext;
+		}
+		chunk.numPendingUpdates -= (itNext -it);
+		prosper::util::BufferCopy copyInfo {};
+		copyInfo.srcOffset = first.srcOffset;
+		copyInfo.dstOffset = first.dstOffset;
+		copyInfo.size = size;
+		drawCmd->RecordCopyBuffer(copyInfo,*chunk.buffer,*first.rootBuffer);
+		it = itNext;
+	}
+
+	for(auto it=updates.begin();it!=updates.end();)
+	{
+		auto *rootBuffer = it->rootBuffer;
+		drawCmd->RecordBufferBarrier(
+			*rootBuffer,
+			prosper::PipelineStageFlags::TransferBit,prosper::PipelineStageFlags::VertexInputBit | prosper::PipelineStageFlags::VertexShaderBit,
+			prosper::AccessFlags::TransferWriteBit,prosper::AccessFlags::VertexAttributeReadBit | prosper::AccessFlags::ShaderReadBit
+		);
+		it = std::find_if(it,updates.end(),[rootBuffer](const Update &update) {return update.rootBuffer != rootBuffer;});
+	}
+}